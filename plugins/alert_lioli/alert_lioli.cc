@@ -1,19 +1,28 @@
 
 // Snort includes
+#include <detection/ips_context.h>
+#include <detection/signature.h>
 #include <events/event.h>
+#include <framework/data_bus.h>
 #include <framework/module.h>
 #include <log/messages.h>
 #include <protocols/packet.h>
+#include <pub_sub/intrinsic_event_ids.h>
 
 // System includes
+#include <atomic>
 #include <cassert>
 #include <iostream>
+#include <optional>
+#include <string_view>
+#include <unordered_map>
 
 // Local includes
 #include "alert_lioli.h"
 #include "flow_data.h"
 #include "lioli_tree_generator.h"
 #include "log_framework.h"
+#include "packet_history.h"
 
 // Global includes
 #include <iostream>
@@ -31,20 +40,109 @@ static const snort::Parameter module_params[] = {
     {"testmode", snort::Parameter::PT_BOOL, nullptr, "false",
      "if set to true it will give consistent output, like using fixed "
      "timestamps"},
+    {"rule_info", snort::Parameter::PT_BOOL, nullptr, "false",
+     "if set alerts include the gid, sid, rev, classification and priority "
+     "of the rule"},
+    {"flow_max_bytes", snort::Parameter::PT_INT, "0:1000000000", "0",
+     "max bytes of text lioli_bind and lioli_tag may add per flow "
+     "(0 = no limit)"},
+    {"flow_max_entries", snort::Parameter::PT_INT, "0:1000000000", "0",
+     "max entries kept per path of a flow (0 = no limit)"},
+    {"flow_keep", snort::Parameter::PT_ENUM, "first | last | reservoir",
+     "first",
+     "entries kept when a flow limit is reached, the first, the last or a "
+     "random sample (per path)"},
+    {"coalesce", snort::Parameter::PT_BOOL, nullptr, "false",
+     "if set all events of a packet are logged as one tree, with an alerts "
+     "list"},
     {nullptr, snort::Parameter::PT_MAX, nullptr, nullptr, nullptr}};
 
+const PegInfo s_pegs[] = {
+    {CountType::SUM, "flow_data_truncated",
+     "Entries dropped from flows, or not added, due to the flow limits"},
+    {CountType::NOW, "flow_data_bytes",
+     "Bytes held by lioli_bind and lioli_tag in all flows"},
+    {CountType::MAX, "flow_data_max_bytes",
+     "Max bytes held by lioli_bind and lioli_tag in all flows"},
+    {CountType::END, nullptr, nullptr}};
+
+// Compile time sanity check of number of entries in s_pegs and s_peg_counts
+static_assert(
+    (sizeof(s_pegs) / sizeof(PegInfo)) - 1 ==
+        sizeof(PegCounts) / sizeof(PegCount),
+    "Entries in s_pegs doesn't match number of entries in s_peg_counts");
+
+// With coalesce, the events of the packet being processed. The parts shared
+// by the events are built by the first one. Packets are reused, so the
+// packet is identified by its context (a pseudo packet has its own) and
+// number
+struct Pending {
+  const snort::IpsContext *context = nullptr;
+  uint64_t packet_number = 0;
+  std::shared_ptr<LioLi::Logger> logger;
+  LioLi::Tree timestamp;
+  LioLi::Tree alerts = {"alerts"};
+  LioLi::Tree rest; // Protocol, history and paths
+};
+
+static THREAD_LOCAL Pending s_pending;
+
+void log_pending() {
+  if (!s_pending.context) {
+    return;
+  }
+
+  LioLi::Tree root("$");
+  root << s_pending.timestamp << s_pending.alerts;
+  root.merge(std::move(s_pending.rest));
+  *s_pending.logger << std::move(root);
+
+  s_pending = Pending();
+}
+
+// Events are logged after detection, so all events of a packet are pending
+// when it is finalized
+class PacketEndHandler : public snort::DataHandler {
+public:
+  PacketEndHandler() : DataHandler(s_name) {}
+
+  void handle(snort::DataEvent &, snort::Flow *) override { log_pending(); }
+};
+
 class Module : public snort::Module {
 
   Module() : snort::Module(s_name, s_help, module_params) {}
 
   std::string logger_name;
   bool testmode = false;
+  bool rule_info = false;
+  bool coalesce = false;
+  FlowLimits flow_limits;
+
+  bool begin(const char *, int, snort::SnortConfig *) override {
+    logger_name.clear();
+    testmode = false;
+    rule_info = false;
+    coalesce = false;
+    flow_limits = FlowLimits();
+    return true;
+  }
 
   bool set(const char *, snort::Value &val, snort::SnortConfig *) override {
     if (val.is("logger") && val.get_as_string().size() > 0) {
       logger_name = val.get_string();
     } else if (val.is("testmode")) {
       testmode = val.get_bool();
+    } else if (val.is("rule_info")) {
+      rule_info = val.get_bool();
+    } else if (val.is("flow_max_bytes")) {
+      flow_limits.max_bytes = val.get_uint32();
+    } else if (val.is("flow_max_entries")) {
+      flow_limits.max_entries = val.get_uint32();
+    } else if (val.is("coalesce")) {
+      coalesce = val.get_bool();
+    } else if (val.is("flow_keep")) {
+      flow_limits.keep = static_cast<FlowLimits::Keep>(val.get_uint8());
     } else {
       // fail if we didn't get something valid
       return false;
@@ -53,68 +151,248 @@ class Module : public snort::Module {
     return true;
   }
 
+  bool end(const char *, int, snort::SnortConfig *sc) override {
+    // Subscribed here, so the handler is on the bus of the configuration
+    // being loaded (also on reload)
+    if (coalesce) {
+      snort::DataBus::subscribe_global(
+          snort::intrinsic_pub_key, snort::IntrinsicEventIds::FINALIZE_PACKET,
+          new PacketEndHandler(), *sc);
+    }
+    return true;
+  }
+
   Usage get_usage() const override { return GLOBAL; }
 
+  const PegInfo *get_pegs() const override { return s_pegs; }
+
+  PegCount *get_counts() const override {
+    return reinterpret_cast<PegCount *>(&s_peg_counts);
+  }
+
 public:
   std::string &get_logger_name() { return logger_name; }
   bool get_testmode() { return testmode; }
+  bool get_rule_info() { return rule_info; }
+  bool get_coalesce() { return coalesce; }
+  const FlowLimits &get_flow_limits() { return flow_limits; }
 
   static snort::Module *ctor() { return new Module(); }
   static void dtor(snort::Module *p) { delete p; }
 };
 
+// Identifies a version of a rule
+struct RuleKey {
+  uint32_t gid;
+  uint32_t sid;
+  uint32_t rev;
+
+  bool operator==(const RuleKey &other) const {
+    return gid == other.gid && sid == other.sid && rev == other.rev;
+  }
+};
+
+struct RuleKeyHash {
+  size_t operator()(const RuleKey &key) const {
+    return std::hash<uint64_t>()((uint64_t(key.gid) << 32 | key.sid) ^
+                                 uint64_t(key.rev) << 48);
+  }
+};
+
+// The parts of an alert that are fixed per rule, built the first time the
+// rule fires. What they are built from is kept, as a reload may change e.g.
+// the classification of a rule without a new rev
+struct RuleTemplate {
+  std::string message;
+  std::string class_name;
+  uint32_t priority = 0;
+  // Memoized, so the message is only escaped and serialized once per rule
+  std::optional<LioLi::Tree> alert; // Type and message, built when first used
+  std::optional<LioLi::Tree> log;
+  std::optional<LioLi::Tree> rule; // Only with rule_info
+};
+
+// Per packet thread, so alerts don't need a lock
+static THREAD_LOCAL std::unordered_map<RuleKey, RuleTemplate, RuleKeyHash>
+    s_rule_templates;
+
+// Loggers are created again by a reload, the templates of a thread are
+// dropped when it sees a new generation, so rules removed by reloads don't
+// pile up
+static std::atomic<uint32_t> s_generation = 0;
+static THREAD_LOCAL uint32_t s_rule_templates_generation = 0;
+
 class Logger : public snort::Logger {
   Module &module;
   bool testmode = true;
+  bool rule_info = false;
+  bool coalesce = false;
 
+  // Resolved when the logger is created, so alerts don't do LogDB lookups
   std::shared_ptr<LioLi::Logger> logger;
 
-  LioLi::Logger &get_logger() {
-    if (!logger) {
-      logger =
-          LioLi::LogDB::get<LioLi::Logger>(module.get_logger_name().c_str());
-    }
-    return *logger.get();
-  }
+  LioLi::Logger &get_logger() { return *logger.get(); }
 
 private:
-  Logger(Module *module) : module(*module), testmode(module->get_testmode()) {
+  Logger(Module *module)
+      : module(*module), testmode(module->get_testmode()),
+        rule_info(module->get_rule_info()),
+        coalesce(module->get_coalesce()),
+        logger(LioLi::LogDB::get<LioLi::Logger>(module->get_logger_name())) {
     assert(module);
+    s_generation++;
+    FlowData::set_limits(
+        std::make_shared<const FlowLimits>(module->get_flow_limits()));
+  }
+
+  void alert(snort::Packet *pkt, const char *msg, const Event &event) override {
+    if (coalesce) {
+      add_pending(true, pkt, msg, &event);
+    } else {
+      get_logger() << std::move(gen_tree(true, pkt, msg, &event));
+    }
+  }
+
+  void log(snort::Packet *pkt, const char *msg, Event *event) override {
+    if (coalesce) {
+      add_pending(false, pkt, msg, event);
+    } else {
+      get_logger() << std::move(gen_tree(false, pkt, msg, event));
+    }
+  }
+
+  void add_pending(bool is_alert, snort::Packet *pkt, const char *msg,
+                   const Event *event) {
+    assert(pkt && msg);
+
+    // Events of a pseudo packet (e.g. reassembled) are logged separately
+    if (s_pending.context != pkt->context ||
+        s_pending.packet_number != pkt->context->packet_number) {
+      log_pending();
+
+      s_pending.context = pkt->context;
+      s_pending.packet_number = pkt->context->packet_number;
+      s_pending.logger = logger;
+      s_pending.timestamp =
+          LioLi::TreeGenerators::timestamp("timestamp", testmode);
+      s_pending.rest = add_packet(LioLi::Tree("$"), pkt);
+    }
+
+    LioLi::Tree event_tree("event");
+    add_message(event_tree, is_alert, msg, event);
+    s_pending.alerts << std::move(event_tree);
   }
 
-  void alert(snort::Packet *pkt, const char *msg, const Event &) override {
-    get_logger() << std::move(gen_tree("alert", pkt, msg));
+  // Returns nullptr if the event has no rule
+  RuleTemplate *get_rule_template(const Event *event, const char *msg) {
+    if (!event || !event->sig_info) {
+      return nullptr;
+    }
+
+    uint32_t generation = s_generation;
+    if (s_rule_templates_generation != generation) {
+      s_rule_templates.clear();
+      s_rule_templates_generation = generation;
+    }
+
+    const SigInfo &sig_info = *event->sig_info;
+    auto &rule_template =
+        s_rule_templates[{sig_info.gid, sig_info.sid, sig_info.rev}];
+    std::string_view class_name;
+    if (sig_info.class_type) {
+      class_name = sig_info.class_type->name;
+    }
+
+    if (rule_template.message != msg ||
+        rule_template.class_name != class_name ||
+        rule_template.priority != sig_info.priority ||
+        rule_template.rule.has_value() != rule_info) {
+      rule_template = {msg, std::string(class_name), sig_info.priority,
+                       {}, {}, {}};
+
+      if (rule_info) {
+        LioLi::Tree rule("rule");
+        rule << (LioLi::Tree("gid") << std::to_string(sig_info.gid))
+             << (LioLi::Tree("sid") << std::to_string(sig_info.sid))
+             << (LioLi::Tree("rev") << std::to_string(sig_info.rev));
+        if (sig_info.class_type) {
+          rule << (LioLi::Tree("class") << sig_info.class_type->name);
+        }
+        rule << (LioLi::Tree("priority") << std::to_string(sig_info.priority));
+        rule.memoize();
+        rule_template.rule = std::move(rule);
+      }
+    }
+
+    return &rule_template;
   }
 
-  void log(snort::Packet *pkt, const char *msg, Event *) override {
-    get_logger() << std::move(gen_tree("log", pkt, msg));
+  // Adds the message and (with rule_info) the rule of the event
+  void add_message(LioLi::Tree &tree, bool is_alert, const char *msg,
+                   const Event *event) {
+    const char *type = is_alert ? "alert" : "log";
+
+    if (auto rule_template = get_rule_template(event, msg)) {
+      auto &message = is_alert ? rule_template->alert : rule_template->log;
+      if (!message) {
+        message.emplace(type);
+        *message << msg;
+        message->memoize();
+      }
+      tree << *message;
+
+      if (rule_template->rule) {
+        tree << *rule_template->rule;
+      }
+    } else {
+      tree << (LioLi::Tree(type) << msg);
+    }
   }
 
-  LioLi::Tree gen_tree(const char *type, snort::Packet *pkt, const char *msg) {
-    assert(type && pkt && msg);
+  LioLi::Tree gen_tree(bool is_alert, snort::Packet *pkt, const char *msg,
+                       const Event *event) {
+    assert(pkt && msg);
 
-    LioLi::Path root("$");
+    LioLi::Tree root("$");
 
     root << LioLi::TreeGenerators::timestamp("timestamp", testmode);
+    add_message(root, is_alert, msg, event);
 
-    root << (LioLi::Tree(type) << msg);
+    return add_packet(std::move(root), pkt);
+  }
 
-    // format_IP_MAC handles a null flow
-    root << (LioLi::Path("$.principal")
-             << LioLi::TreeGenerators::format_IP_MAC(pkt, pkt->flow, true));
+  // Adds what is known about the packet and its flow
+  LioLi::Tree add_packet(LioLi::Tree &&root, snort::Packet *pkt) {
+    // The rest is added in path order, merged with the paths of the flow
+    LioLi::TreeBuilder builder;
+
+    if (!pkt->flow) {
+      // format_IP_MAC handles a null flow
+      auto principal = LioLi::TreeGenerators::format_IP_MAC(pkt, nullptr, true);
+      auto endpoint = LioLi::TreeGenerators::format_IP_MAC(pkt, nullptr, false);
+
+      builder.add("$.principal", principal).add("$.endpoint", endpoint);
+      return builder.build(std::move(root));
+    }
 
-    root << (LioLi::Path("$.endpoint")
-             << LioLi::TreeGenerators::format_IP_MAC(pkt, pkt->flow, false));
+    // The addresses and protocol are the same for every alert on the flow,
+    // so they are built by the first alert and reused
+    FlowData &flow_data = *FlowData::get_from_flow(pkt->flow);
+    flow_data.flush();
 
-    if (pkt->flow && pkt->flow->service) {
-      root << (LioLi::Tree("protocol") << pkt->flow->service);
+    if (auto protocol = flow_data.get_protocol(pkt->flow)) {
+      root << *protocol;
     }
 
-    if (pkt->flow) {
-      root << *FlowData::get_from_flow(pkt->flow);
+    // The last packets of the flow, only kept with lioli_history
+    if (auto history = PacketHistory::get(pkt->flow)) {
+      root << history->gen_tree();
     }
 
-    return root.to_tree();
+    builder.add("$.principal", flow_data.get_principal_addr(pkt))
+        .add("$.endpoint", flow_data.get_endpoint_addr(pkt))
+        .add(flow_data);
+    return builder.build(std::move(root));
   }
 
 public:
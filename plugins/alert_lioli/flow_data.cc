@@ -2,14 +2,48 @@
 // Snort includes
 
 // System includes
+#include <algorithm>
+#include <atomic>
 #include <cassert>
+#include <deque>
+#include <mutex>
+#include <shared_mutex>
+#include <unordered_map>
+#include <vector>
 
 // Local includes
 #include "flow_data.h"
+#include "lioli_tree_generator.h"
 
 namespace alert_lioli {
 
-FlowData::FlowData() : snort::FlowData(get_id()) {}
+THREAD_LOCAL struct PegCounts s_peg_counts;
+
+namespace {
+
+// Set by the alert_lioli logger, replaced on reload while packet threads
+// create flows
+std::atomic<FlowLimitsHandle> s_limits{std::make_shared<const FlowLimits>()};
+
+// Paths by id, ids are never reused, so flows can keep them over a reload.
+// Ids are added when rules are loaded, while packet threads flush captures
+std::shared_mutex s_paths_mutex;
+std::deque<std::string> s_paths;
+std::unordered_map<std::string, uint32_t> s_path_ids;
+
+// Tags by path and text, only used when rules are loaded
+std::mutex s_tags_mutex;
+std::unordered_map<std::string, uint32_t> s_tag_ids;
+
+} // namespace
+
+FlowData::FlowData() : snort::FlowData(get_id()), limits(s_limits.load()) {}
+
+FlowData::~FlowData() { release(bytes); }
+
+void FlowData::set_limits(FlowLimitsHandle limits) {
+  s_limits.store(std::move(limits));
+}
 
 unsigned FlowData::get_id() {
   static unsigned flow_data_id = snort::FlowData::create_flow_data_id();
@@ -30,6 +64,220 @@ FlowData *FlowData::get_from_flow(snort::Flow *flow) {
   return flow_data;
 }
 
+void FlowData::hold(size_t size) {
+  bytes += size;
+  s_peg_counts.flow_data_bytes += size;
+  s_peg_counts.flow_data_max_bytes = std::max(
+      s_peg_counts.flow_data_max_bytes, s_peg_counts.flow_data_bytes);
+}
+
+void FlowData::release(size_t size) {
+  bytes -= size;
+  s_peg_counts.flow_data_bytes -= size;
+}
+
+// Only the text added to the flow is counted, not the snapshots and
+// serialized forms alerts build from it, so a flow is truncated at the same
+// entry whatever the serializer and however the logger runs
+void FlowData::update_bytes() {
+  size_t held = size() + capture_data.size();
+
+  if (held > bytes) {
+    hold(held - bytes);
+  } else {
+    release(bytes - held);
+  }
+}
+
+bool FlowData::fits(size_t size) const {
+  return !limits->max_bytes || bytes + size <= limits->max_bytes;
+}
+
+void FlowData::drop(const std::string &key, Entries &path_entries,
+                    size_t index) {
+  auto &kept = path_entries.kept;
+  size_t pos = 0;
+
+  for (size_t i = 0; i < index; i++) {
+    pos += kept[i].bytes;
+  }
+  erase_text(key, pos, kept[index].bytes);
+  kept.erase(kept.begin() + index);
+  s_peg_counts.flow_data_truncated++;
+
+  update_bytes();
+}
+
+// Returns false if there is nothing to drop
+bool FlowData::drop_oldest() {
+  std::pair<const std::string, Entries> *oldest = nullptr;
+
+  for (auto &key_entries : entries) {
+    auto &kept = key_entries.second.kept;
+    if (!kept.empty() &&
+        (!oldest || kept.front().order < oldest->second.kept.front().order)) {
+      oldest = &key_entries;
+    }
+  }
+
+  if (!oldest) {
+    return false;
+  }
+  drop(oldest->first, oldest->second, 0);
+  return true;
+}
+
+void FlowData::add(const std::string &key, std::string_view text) {
+  size_t size = text.size();
+
+  flush(); // Keeps the order of what is added to the same path
+
+  if (!limits->is_limited()) {
+    add_text(key, text);
+    update_bytes();
+    return;
+  }
+
+  auto &path_entries = entries[key];
+  auto &kept = path_entries.kept;
+  bool full = limits->max_entries && kept.size() >= limits->max_entries;
+
+  path_entries.seen++;
+
+  switch (limits->keep) {
+  case FlowLimits::Keep::first:
+    if (full) {
+      s_peg_counts.flow_data_truncated++;
+      return;
+    }
+    break;
+
+  case FlowLimits::Keep::last:
+    if (limits->max_bytes && size > limits->max_bytes) {
+      s_peg_counts.flow_data_truncated++;
+      return;
+    }
+    if (full) {
+      drop(key, path_entries, 0);
+    }
+    while (!fits(size) && drop_oldest()) {
+    }
+    break;
+
+  case FlowLimits::Keep::reservoir:
+    if (full || !fits(size)) {
+      // The n:th entry of the path replaces a random one of the k kept with
+      // probability k / n, if it fits in place of it
+      size_t replace = random() % path_entries.seen;
+
+      if (replace >= kept.size() ||
+          (limits->max_bytes &&
+           bytes - kept[replace].bytes + size > limits->max_bytes)) {
+        s_peg_counts.flow_data_truncated++;
+        return;
+      }
+      drop(key, path_entries, replace);
+    }
+    break;
+  }
+
+  if (!fits(size)) {
+    s_peg_counts.flow_data_truncated++;
+    return;
+  }
+
+  kept.push_back({added++, size});
+  add_text(key, text);
+  update_bytes();
+}
+
+uint32_t FlowData::get_path_id(const std::string &path) {
+  std::unique_lock lock(s_paths_mutex);
+
+  auto [itr, added] = s_path_ids.emplace(path, s_paths.size());
+  if (added) {
+    s_paths.push_back(path);
+  }
+  return itr->second;
+}
+
+uint32_t FlowData::get_tag_id(const std::string &path,
+                              const std::string &text) {
+  std::scoped_lock lock(s_tags_mutex);
+
+  // A path has no spaces, so the key is the same only for the same tag
+  return s_tag_ids.emplace(path + ' ' + text, s_tag_ids.size()).first->second;
+}
+
+void FlowData::capture(uint32_t path_id, std::string_view text) {
+  if (limits->is_limited()) {
+    std::string path;
+    {
+      std::shared_lock lock(s_paths_mutex);
+      path = s_paths[path_id];
+    }
+    add(path, text);
+    return;
+  }
+
+  captures.push_back({path_id, static_cast<uint32_t>(capture_data.size()),
+                      static_cast<uint32_t>(text.size())});
+  capture_data += text;
+  hold(text.size());
+}
+
+void FlowData::flush() {
+  if (captures.empty()) {
+    return;
+  }
+
+  std::shared_lock lock(s_paths_mutex);
+  std::string_view data(capture_data);
+
+  for (auto &capture : captures) {
+    add_text(s_paths[capture.path_id],
+             data.substr(capture.offset, capture.length));
+  }
+  captures.clear();
+  capture_data.clear();
+
+  update_bytes();
+}
+
+const LioLi::Tree &FlowData::get_principal_addr(const snort::Packet *pkt) {
+  assert(pkt->flow);
+
+  if (!principal_addr) {
+    principal_addr = LioLi::TreeGenerators::format_IP_MAC(pkt, pkt->flow, true);
+    principal_addr->memoize();
+  }
+  return *principal_addr;
+}
+
+const LioLi::Tree &FlowData::get_endpoint_addr(const snort::Packet *pkt) {
+  assert(pkt->flow);
+
+  if (!endpoint_addr) {
+    endpoint_addr = LioLi::TreeGenerators::format_IP_MAC(pkt, pkt->flow, false);
+    endpoint_addr->memoize();
+  }
+  return *endpoint_addr;
+}
+
+const LioLi::Tree *FlowData::get_protocol(const snort::Flow *flow) {
+  if (!flow->service) {
+    return nullptr;
+  }
+
+  // The service may be identified (or change) after the first alert
+  if (!protocol || protocol_service != flow->service) {
+    protocol.emplace("protocol");
+    *protocol << flow->service;
+    protocol_service = flow->service;
+  }
+  return &*protocol;
+}
+
 // void FlowData::add(std::string &&text) { queue.emplace(std::move(text)); }
 
 // void FlowData::add(LioLi::Tree &&tree) { queue.emplace(std::move(tree)); }
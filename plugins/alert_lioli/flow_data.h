@@ -7,24 +7,142 @@
 // Snort includes
 #include <flow/flow.h>
 #include <flow/flow_data.h>
+#include <framework/counts.h>
+#include <protocols/packet.h>
 
 // System includes
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <optional>
 #include <queue>
+#include <random>
 #include <string>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
 #include <variant>
+#include <vector>
 
 // Local includes
 #include "lioli_path.h"
 
 namespace alert_lioli {
 
+// This must match the s_pegs[] array
+struct PegCounts {
+  PegCount flow_data_truncated = 0;
+  PegCount flow_data_bytes = 0;
+  PegCount flow_data_max_bytes = 0;
+};
+
+// This must match the s_pegs[] array
+extern THREAD_LOCAL struct PegCounts s_peg_counts;
+
+// Limits of what lioli_bind and lioli_tag add to a flow, 0 = no limit
+struct FlowLimits {
+  enum class Keep : uint8_t {
+    first,    // Entries beyond the limits are dropped
+    last,     // The oldest entries are dropped to make room
+    reservoir // A uniform random sample of the entries of each path is kept
+  };
+
+  size_t max_bytes = 0;
+  size_t max_entries = 0; // Per path
+  Keep keep = Keep::first;
+
+  bool is_limited() const { return max_bytes || max_entries; }
+};
+
+// Immutable limits, flows keep the ones set when they were created
+using FlowLimitsHandle = std::shared_ptr<const FlowLimits>;
+
 class FlowData : public snort::FlowData, public LioLi::Path {
   // std::queue<std::variant<std::string, LioLi::Tree>> queue;
 
+  // Parts of the alert that are the same for every alert on the flow, built
+  // by the first alert needing them
+  std::optional<LioLi::Tree> principal_addr;
+  std::optional<LioLi::Tree> endpoint_addr;
+  std::optional<LioLi::Tree> protocol;
+  const char *protocol_service = nullptr; // Service protocol was built from
+
+  FlowLimitsHandle limits;
+  size_t bytes = 0; // Text of the path and the captures
+
+  // With limits, the entries added at each path, oldest first. Their text
+  // follows each other in the tree of the path, so an entry is dropped by
+  // cutting it out of that tree, the text isn't kept anywhere else
+  struct Entry {
+    uint64_t order; // Of all entries of the flow
+    size_t bytes;
+  };
+  struct Entries {
+    std::deque<Entry> kept;
+    uint64_t seen = 0;
+  };
+  std::unordered_map<std::string, Entries> entries;
+  uint64_t added = 0;
+  std::minstd_rand random;
+
+  // Tags added with once
+  std::unordered_set<uint32_t> tag_ids;
+
+  // What lioli_bind captured since the last flush(), the text of all
+  // captures follows each other in capture_data
+  struct Capture {
+    uint32_t path_id;
+    uint32_t offset;
+    uint32_t length;
+  };
+  std::vector<Capture> captures;
+  std::string capture_data;
+
+  void hold(size_t size);
+  void release(size_t size);
+  void update_bytes();
+  bool fits(size_t size) const;
+  void drop(const std::string &key, Entries &path_entries, size_t index);
+  bool drop_oldest();
+
 public:
   FlowData();
+  ~FlowData();
   unsigned static get_id();
 
+  // Used by flows created after the call
+  static void set_limits(FlowLimitsHandle limits);
+
+  // Adds text to the tree at the absolute path key (for lioli_bind and
+  // lioli_tag) within the limits of the flow
+  void add(const std::string &key, std::string_view text);
+
+  // Tags are given ids when rules are loaded, the same path and text always
+  // get the same id, so the flow only needs to store the ids for once
+  static uint32_t get_tag_id(const std::string &path, const std::string &text);
+
+  // Returns false if the tag has been added to the flow before
+  bool add_tag_id(uint32_t id) { return tag_ids.insert(id).second; }
+
+  // Paths are given ids when rules are loaded, so lioli_bind only needs to
+  // store the id with what it captures
+  static uint32_t get_path_id(const std::string &path);
+
+  // Adds the text to the tree at the path, as add() does. Without limits it
+  // is only stored, the path is updated by flush()
+  void capture(uint32_t path_id, std::string_view text);
+
+  // Adds what has been captured to the path, must be done before it is used
+  void flush();
+
+  // Addresses of the client (principal) and server (endpoint) of the flow of
+  // pkt, memoized so they are also only serialized once
+  const LioLi::Tree &get_principal_addr(const snort::Packet *pkt);
+  const LioLi::Tree &get_endpoint_addr(const snort::Packet *pkt);
+
+  // Returns nullptr until the service of the flow is known
+  const LioLi::Tree *get_protocol(const snort::Flow *flow);
+
   // void add(std::string &&text); // Adds a string to flow data
   // void add(LioLi::Tree &&tree); // Adds a Lioli tree to flow data
 
@@ -9,8 +9,10 @@
 // System includes
 #include <cassert>
 #include <string>
+#include <string_view>
 
 // Local includes
+#include "digest.h"
 #include "flow_data.h"
 #include "ips_lioli_bind.h"
 
@@ -26,19 +28,110 @@ static const char *s_help = "generates lioli node from current cursor position";
 
 static const snort::Parameter module_params[] = {
     {"~", snort::Parameter::PT_STRING, nullptr, nullptr, "name of lioli node"},
+    {"max_len", snort::Parameter::PT_INT, "0:65535", "0",
+     "max bytes captured, before hex encoding (0 = no limit)"},
+    {"head", snort::Parameter::PT_IMPLIED, nullptr, nullptr,
+     "with max_len, the first bytes are captured (default)"},
+    {"tail", snort::Parameter::PT_IMPLIED, nullptr, nullptr,
+     "with max_len, the last bytes are captured"},
+    {"hex", snort::Parameter::PT_IMPLIED, nullptr, nullptr,
+     "capture the bytes as hex digits"},
+    {"sha256", snort::Parameter::PT_IMPLIED, nullptr, nullptr,
+     "capture the SHA-256 digest (in hex) of the bytes"},
+    {"xxh64", snort::Parameter::PT_IMPLIED, nullptr, nullptr,
+     "capture the XXH64 digest (in hex) of the bytes"},
     {nullptr, snort::Parameter::PT_MAX, nullptr, nullptr, nullptr}};
 
+// What is captured of the cursor data
+struct Transform {
+  enum class Encoding : uint8_t { raw, hex, sha256, xxh64 };
+
+  uint32_t max_len = 0; // 0 = all
+  bool tail = false;    // With max_len, the last bytes are kept
+  Encoding encoding = Encoding::raw;
+
+  bool operator==(const Transform &) const = default;
+
+  // Returns data or, if encoded, buffer
+  std::string_view apply(std::string_view data, std::string &buffer) const {
+    if (max_len && data.size() > max_len) {
+      data = tail ? data.substr(data.size() - max_len)
+                  : data.substr(0, max_len);
+    }
+
+    buffer.clear();
+    switch (encoding) {
+    case Encoding::raw:
+      return data;
+    case Encoding::hex:
+      Common::append_hex(data, buffer);
+      break;
+    case Encoding::sha256: {
+      auto digest = Common::sha256(data);
+      Common::append_hex(std::string_view(
+                             reinterpret_cast<const char *>(digest.data()),
+                             digest.size()),
+                         buffer);
+      break;
+    }
+    case Encoding::xxh64: {
+      // Canonical (big endian) form
+      uint64_t digest = Common::xxh64(data);
+      char bytes[8];
+      for (size_t i = 0; i < sizeof(bytes); i++) {
+        bytes[i] = static_cast<char>(digest >> (56 - i * 8));
+      }
+      Common::append_hex(std::string_view(bytes, sizeof(bytes)), buffer);
+      break;
+    }
+    }
+    return buffer;
+  }
+};
+
 class Module : public snort::Module {
   std::string node_name;
+  Transform transform;
+  bool head = false;
+  unsigned encodings = 0;
 
   Module() : snort::Module(s_name, s_help, module_params) {}
 
   bool begin(const char *, int, snort::SnortConfig *) override {
     node_name.clear();
+    transform = Transform();
+    head = false;
+    encodings = 0;
     return true;
   }
 
-  bool end(const char *, int, snort::SnortConfig *) override { return true; }
+  bool end(const char *, int, snort::SnortConfig *) override {
+    bool digest = transform.encoding == Transform::Encoding::sha256 ||
+                  transform.encoding == Transform::Encoding::xxh64;
+
+    if (encodings > 1) {
+      snort::ErrorMessage(
+          "ERROR: only one of hex, sha256 and xxh64 can be used in %s\n",
+          s_name);
+      return false;
+    }
+    if (head && transform.tail) {
+      snort::ErrorMessage("ERROR: head and tail cannot be combined in %s\n",
+                          s_name);
+      return false;
+    }
+    if ((head || transform.tail) && !transform.max_len) {
+      snort::ErrorMessage("ERROR: head and tail need max_len in %s\n",
+                          s_name);
+      return false;
+    }
+    if (digest && transform.max_len) {
+      snort::ErrorMessage(
+          "ERROR: max_len cannot be combined with a digest in %s\n", s_name);
+      return false;
+    }
+    return true;
+  }
 
   bool set(const char *, snort::Value &val, snort::SnortConfig *) override {
     if (val.is("~")) {
@@ -50,6 +143,27 @@ class Module : public snort::Module {
         return false;
       }
 
+      return true;
+    } else if (val.is("max_len")) {
+      transform.max_len = val.get_uint32();
+      return true;
+    } else if (val.is("head")) {
+      head = true;
+      return true;
+    } else if (val.is("tail")) {
+      transform.tail = true;
+      return true;
+    } else if (val.is("hex")) {
+      transform.encoding = Transform::Encoding::hex;
+      encodings++;
+      return true;
+    } else if (val.is("sha256")) {
+      transform.encoding = Transform::Encoding::sha256;
+      encodings++;
+      return true;
+    } else if (val.is("xxh64")) {
+      transform.encoding = Transform::Encoding::xxh64;
+      encodings++;
       return true;
     }
 
@@ -65,19 +179,31 @@ public:
   static void dtor(snort::Module *p) { delete p; }
 
   std::string get_node_name() { return node_name; }
+  const Transform &get_transform() const { return transform; }
 };
 
+// Encoded captures are built here, before they are copied to the flow
+static THREAD_LOCAL std::string s_buffer;
+
 class IpsOption : public snort::IpsOption {
 
   std::string node_name;
+  uint32_t path_id;
+  Transform transform;
 
   IpsOption(Module &module)
-      : snort::IpsOption(s_name), node_name(module.get_node_name()) {}
+      : snort::IpsOption(s_name), node_name(module.get_node_name()),
+        path_id(alert_lioli::FlowData::get_path_id(node_name)),
+        transform(module.get_transform()) {}
 
   // Hash compare is used as a fast way to compare two instances of IpsOption
   uint32_t hash() const override {
-    uint32_t a = snort::IpsOption::hash(), b = node_name.length(), c = 0;
+    uint32_t a = snort::IpsOption::hash(), b = node_name.length(),
+             c = transform.max_len;
 
+    mix(a, b, c);
+    a += static_cast<uint32_t>(transform.encoding);
+    b += transform.tail;
     mix(a, b, c);
     finalize(a, b, c);
 
@@ -88,7 +214,8 @@ class IpsOption : public snort::IpsOption {
   bool operator==(const snort::IpsOption &ips) const override {
     return snort::IpsOption::operator==(ips) &&
            dynamic_cast<const IpsOption &>(ips).node_name.compare(node_name) ==
-               0;
+               0 &&
+           dynamic_cast<const IpsOption &>(ips).transform == transform;
   }
 
   EvalStatus eval(Cursor &c, snort::Packet *p) override {
@@ -99,12 +226,11 @@ class IpsOption : public snort::IpsOption {
     alert_lioli::FlowData *flow_data =
         alert_lioli::FlowData::get_from_flow(p->flow);
 
-    const uint8_t *startpos = c.start();
-    unsigned length = c.length();
-
-    std::string content((char *)startpos, length);
+    std::string_view data(reinterpret_cast<const char *>(c.start()),
+                          c.length());
 
-    *flow_data << std::move(LioLi::Path(node_name) << content);
+    // Only stored, the path is built when the flow data is used
+    flow_data->capture(path_id, transform.apply(data, s_buffer));
 
     return MATCH;
   }
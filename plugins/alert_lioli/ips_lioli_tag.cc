@@ -28,17 +28,25 @@ static const char *s_help = "generates lioli tag node from parameter";
 static const snort::Parameter module_params[] = {
     {"~", snort::Parameter::PT_STRING, nullptr, nullptr,
      "tag that should be added"},
+    {"once", snort::Parameter::PT_IMPLIED, nullptr, nullptr,
+     "add the tag only the first time it matches on a flow"},
     {nullptr, snort::Parameter::PT_MAX, nullptr, nullptr, nullptr}};
 
 class Module : public snort::Module {
 
-  LioLi::Path tag;
+  std::string tag_path;
+  std::string tag_text;
+  uint32_t tag_id = 0;
+  bool once = false;
   bool tag_valid = false;
 
   Module() : snort::Module(s_name, s_help, module_params) {}
 
   bool begin(const char *, int, snort::SnortConfig *) override {
-    tag = std::move(LioLi::Path());
+    tag_path.clear();
+    tag_text.clear();
+    tag_id = 0;
+    once = false;
     tag_valid = false;
     return true;
   }
@@ -62,10 +70,15 @@ class Module : public snort::Module {
         // regex_path_name() (note, this is done compile time)
         constexpr int parenthesis_count =
             std::ranges::count(LioLi::Path::regex_path_name(), '(');
-        tag << (LioLi::Path(sm[1]) << sm[2 + parenthesis_count]);
+        tag_path = sm[1];
+        tag_text = sm[2 + parenthesis_count];
+        tag_id = alert_lioli::FlowData::get_tag_id(tag_path, tag_text);
         tag_valid = true;
         return true;
       }
+    } else if (val.is("once")) {
+      once = true;
+      return true;
     }
 
     // fail if we didn't get something valid
@@ -79,18 +92,27 @@ public:
 
   static void dtor(snort::Module *p) { delete p; }
 
-  LioLi::Path &get_tag() { return tag; }
+  const std::string &get_tag_path() const { return tag_path; }
+  const std::string &get_tag_text() const { return tag_text; }
+  uint32_t get_tag_id() const { return tag_id; }
+  bool get_once() const { return once; }
 };
 
 class IpsOption : public snort::IpsOption {
 
-  LioLi::Path tag;
+  std::string tag_path;
+  std::string tag_text;
+  uint32_t tag_id; // Same for options with the same path and text
+  bool once;
 
-  IpsOption(Module &module) : snort::IpsOption(s_name), tag(module.get_tag()) {}
+  IpsOption(Module &module)
+      : snort::IpsOption(s_name), tag_path(module.get_tag_path()),
+        tag_text(module.get_tag_text()), tag_id(module.get_tag_id()),
+        once(module.get_once()) {}
 
   // Hash compare is used as a fast way to compare two instances of IpsOption
   uint32_t hash() const override {
-    uint32_t a = snort::IpsOption::hash(), b = tag.hash(), c = 0;
+    uint32_t a = snort::IpsOption::hash(), b = tag_id, c = once;
 
     mix(a, b, c);
     finalize(a, b, c);
@@ -101,7 +123,8 @@ class IpsOption : public snort::IpsOption {
   // If hashes match a real comparison check is made
   bool operator==(const snort::IpsOption &ips) const override {
     return snort::IpsOption::operator==(ips) &&
-           (dynamic_cast<const IpsOption &>(ips).tag == tag);
+           dynamic_cast<const IpsOption &>(ips).tag_id == tag_id &&
+           dynamic_cast<const IpsOption &>(ips).once == once;
   }
 
   EvalStatus eval(Cursor &, snort::Packet *p) override {
@@ -112,7 +135,10 @@ class IpsOption : public snort::IpsOption {
     alert_lioli::FlowData *flow_data =
         alert_lioli::FlowData::get_from_flow(p->flow);
 
-    *flow_data << tag;
+    // Checked before the tag is added, so a repeated match costs a lookup
+    if (!once || flow_data->add_tag_id(tag_id)) {
+      flow_data->add(tag_path, tag_text);
+    }
 
     return MATCH;
   }
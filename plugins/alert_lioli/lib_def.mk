@@ -12,10 +12,14 @@ CC_FILES := \
 	flow_data.cc \
 	ips_lioli_bind.cc \
 	ips_lioli_tag.cc \
+	lioli_history.cc \
+	packet_history.cc \
 
 H_FILES = \
 	alert_lioli.h \
 	flow_data.h \
 	ips_lioli_bind.h \
 	ips_lioli_tag.h \
+	lioli_history.h \
+	packet_history.h \
 
@@ -0,0 +1,114 @@
+// Snort includes
+#include <framework/decode_data.h>
+#include <framework/inspector.h>
+#include <framework/module.h>
+#include <protocols/packet.h>
+
+// System includes
+#include <cassert>
+
+// Local includes
+#include "lioli_history.h"
+#include "packet_history.h"
+
+// Debug includes
+
+namespace lioli_history {
+namespace {
+
+static const char *s_name = "lioli_history";
+static const char *s_help =
+    "keeps the last packets of each flow, alert_lioli adds them to alerts";
+
+static const snort::Parameter module_params[] = {
+    {"packets", snort::Parameter::PT_INT, "1:256", "8",
+     "number of packets kept per flow"},
+    {"payload", snort::Parameter::PT_INT, "0:1500", "16",
+     "number of payload bytes kept per packet"},
+    {nullptr, snort::Parameter::PT_MAX, nullptr, nullptr, nullptr}};
+
+class Module : public snort::Module {
+  Module() : snort::Module(s_name, s_help, module_params) {}
+
+  Usage get_usage() const override { return INSPECT; }
+
+  uint32_t packets = 8;
+  uint16_t payload = 16;
+
+  bool set(const char *, snort::Value &val, snort::SnortConfig *) override {
+    if (val.is("packets")) {
+      packets = val.get_uint32();
+    } else if (val.is("payload")) {
+      payload = static_cast<uint16_t>(val.get_uint32());
+    } else {
+      // fail if we didn't get something valid
+      return false;
+    }
+
+    return true;
+  }
+
+public:
+  uint32_t get_packets() const { return packets; }
+  uint16_t get_payload() const { return payload; }
+
+  static snort::Module *ctor() { return new Module(); }
+  static void dtor(snort::Module *p) { delete p; }
+};
+
+class Inspector : public snort::Inspector {
+  uint32_t packets;
+  uint16_t payload;
+
+  Inspector(Module *module)
+      : packets(module->get_packets()), payload(module->get_payload()) {}
+
+  void eval(snort::Packet *pkt) override {
+    // Only the history is attached to the flow, alert_lioli adds the rest
+    // of what it keeps when the flow alerts
+    if (pkt && pkt->flow) {
+      alert_lioli::PacketHistory::get_from_flow(pkt->flow, packets, payload)
+          .record(pkt);
+    }
+  }
+
+public:
+  static snort::Inspector *ctor(snort::Module *module) {
+    assert(module);
+    return new Inspector(dynamic_cast<Module *>(module));
+  }
+
+  static void dtor(snort::Inspector *p) { delete dynamic_cast<Inspector *>(p); }
+};
+
+} // namespace
+
+const snort::InspectApi inspect_api = {
+    {
+        PT_INSPECTOR,
+        sizeof(snort::InspectApi),
+        INSAPI_VERSION,
+        0,
+        API_RESERVED,
+        API_OPTIONS,
+        s_name,
+        s_help,
+        Module::ctor,
+        Module::dtor,
+    },
+
+    snort::IT_PACKET,
+    PROTO_BIT__ALL,
+    nullptr, // buffers
+    nullptr, // service
+    nullptr, // pinit
+    nullptr, // pterm
+    nullptr, // tinit
+    nullptr, // tterm
+    Inspector::ctor,
+    Inspector::dtor,
+    nullptr, // ssn
+    nullptr  // reset
+};
+
+} // namespace lioli_history
@@ -0,0 +1,18 @@
+#ifndef lioli_history_9a3e51c6
+#define lioli_history_9a3e51c6
+
+// Snort includes
+#include <framework/base_api.h>
+#include <framework/inspector.h>
+
+// System includes
+
+// Local includes
+
+namespace lioli_history {
+
+extern const snort::InspectApi inspect_api;
+
+} // namespace lioli_history
+
+#endif // #ifndef lioli_history_9a3e51c6
@@ -0,0 +1,120 @@
+
+// Snort includes
+
+// System includes
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <cstring>
+#include <format>
+#include <string_view>
+
+// Local includes
+#include "digest.h"
+#include "packet_history.h"
+
+namespace alert_lioli {
+
+PacketHistory::PacketHistory(uint32_t packets, uint16_t max_payload)
+    : snort::FlowData(get_id()), packets(packets), max_payload(max_payload) {
+  assert(packets > 0);
+}
+
+unsigned PacketHistory::get_id() {
+  static unsigned flow_data_id = snort::FlowData::create_flow_data_id();
+  return flow_data_id;
+}
+
+PacketHistory &PacketHistory::get_from_flow(snort::Flow *flow,
+                                            uint32_t packets,
+                                            uint16_t max_payload) {
+  assert(flow);
+
+  PacketHistory *history =
+      dynamic_cast<PacketHistory *>(flow->get_flow_data(get_id()));
+
+  if (!history) {
+    history = new PacketHistory(packets, max_payload);
+    flow->set_flow_data(history);
+  }
+
+  return *history;
+}
+
+const PacketHistory *PacketHistory::get(const snort::Flow *flow) {
+  assert(flow);
+
+  return dynamic_cast<const PacketHistory *>(flow->get_flow_data(get_id()));
+}
+
+void PacketHistory::record(const snort::Packet *pkt) {
+  if (ring.size() < packets) {
+    // Until it is full next is the end of the ring
+    ring.emplace_back();
+    slab.resize(ring.size() * max_payload);
+  }
+
+  Summary &summary = ring[next];
+  const struct timeval *time = pkt->pkth_ts();
+
+  summary.time = time ? *time : timeval{};
+  summary.size = pkt->pktlen;
+  summary.payload_size = std::min<uint32_t>(pkt->dsize, max_payload);
+  summary.is_tcp = pkt->is_tcp() && pkt->ptrs.tcph;
+  summary.tcp_flags = summary.is_tcp ? pkt->ptrs.tcph->th_flags : 0;
+  summary.from_client = pkt->is_from_client();
+
+  if (summary.payload_size) {
+    std::memcpy(&slab[size_t(next) * max_payload], pkt->data,
+                summary.payload_size);
+  }
+
+  next = (next + 1) % packets;
+}
+
+LioLi::Tree PacketHistory::gen_tree() const {
+  // Bit 0 (FIN) first
+  static const char flag_names[] = "FSRPAUEC";
+  LioLi::Tree history("history");
+
+  uint32_t count = ring.size();
+
+  for (uint32_t i = 0; i < count; i++) {
+    uint32_t index = (next + packets - count + i) % packets;
+    const Summary &summary = ring[index];
+    LioLi::Tree packet("packet");
+
+    auto time = std::chrono::sys_seconds(
+                    std::chrono::seconds(summary.time.tv_sec)) +
+                std::chrono::microseconds(summary.time.tv_usec);
+    packet << (LioLi::Tree("time") << std::format("{:%FT%TZ}", time))
+           << (LioLi::Tree("dir")
+               << (summary.from_client ? "client" : "server"))
+           << (LioLi::Tree("size") << std::to_string(summary.size));
+
+    if (summary.is_tcp) {
+      std::string flags;
+      for (unsigned bit = 0; bit < 8; bit++) {
+        if (summary.tcp_flags & (1 << bit)) {
+          flags += flag_names[bit];
+        }
+      }
+      packet << (LioLi::Tree("flags") << flags);
+    }
+
+    if (summary.payload_size) {
+      std::string payload;
+      Common::append_hex(
+          std::string_view(reinterpret_cast<const char *>(
+                               &slab[size_t(index) * max_payload]),
+                           summary.payload_size),
+          payload);
+      packet << (LioLi::Tree("payload") << payload);
+    }
+
+    history << std::move(packet);
+  }
+  return history;
+}
+
+} // namespace alert_lioli
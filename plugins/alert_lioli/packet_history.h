@@ -0,0 +1,59 @@
+#ifndef packet_history_41c7e2d8
+#define packet_history_41c7e2d8
+
+// Snort includes
+#include <flow/flow.h>
+#include <flow/flow_data.h>
+#include <protocols/packet.h>
+
+// System includes
+#include <cstdint>
+#include <sys/time.h>
+#include <vector>
+
+// Local includes
+#include "lioli.h"
+
+namespace alert_lioli {
+
+// The last packets of a flow, kept by lioli_history so alerts can show what
+// led up to them. It is flow data of its own, so flows that never alert only
+// carry their history. The ring grows with the packets recorded until it
+// holds packets of them, after that recording a packet only overwrites the
+// oldest one
+class PacketHistory : public snort::FlowData {
+  struct Summary {
+    struct timeval time;
+    uint32_t size;
+    uint16_t payload_size; // Bytes kept in the slab
+    uint8_t tcp_flags;
+    bool is_tcp;
+    bool from_client;
+  };
+
+  const uint32_t packets;
+  const uint16_t max_payload;
+  std::vector<Summary> ring;
+  std::vector<uint8_t> slab; // max_payload bytes per packet of the ring
+  uint32_t next = 0;         // Where the next packet goes
+
+public:
+  PacketHistory(uint32_t packets, uint16_t max_payload);
+  unsigned static get_id();
+
+  // Created by the first call for the flow, the sizes are fixed from then on
+  static PacketHistory &get_from_flow(snort::Flow *flow, uint32_t packets,
+                                      uint16_t max_payload);
+
+  // Returns nullptr if no packets have been recorded on the flow
+  static const PacketHistory *get(const snort::Flow *flow);
+
+  void record(const snort::Packet *pkt);
+
+  // The recorded packets, oldest first
+  LioLi::Tree gen_tree() const;
+};
+
+} // namespace alert_lioli
+
+#endif // #ifndef packet_history_41c7e2d8
@@ -0,0 +1,301 @@
+// Round trip test and decode benchmark for LioLi::Bill::Reader, built and run
+// by "make bill-bench". Only uses the LioLi sources, so it doesn't need Snort.
+//
+// Usage: bill_bench [file.bill ...]
+//   Without arguments random trees are written with LioLi, read back and
+//   compared, then the decode throughput is measured. Files (e.g. written by
+//   serializer_bill) are memory mapped and their decode throughput measured.
+
+// System includes
+#include <chrono>
+#include <cstdio>
+#include <fcntl.h>
+#include <random>
+#include <string>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+
+// Local includes
+#include "lioli.h"
+#include "lioli_bill.h"
+
+namespace {
+
+std::mt19937 rng(4711);
+
+size_t pick(size_t n) {
+  return std::uniform_int_distribution<size_t>(0, n - 1)(rng);
+}
+
+// Mostly short text, so all three position encodings are used
+std::string random_text() {
+  static const size_t lengths[] = {0, 1, 3, 8, 15, 16, 40, 63, 64, 255, 256};
+  std::string text(lengths[pick(std::size(lengths))], ' ');
+  for (auto &c : text) {
+    c = static_cast<char>(pick(256));
+  }
+  return text;
+}
+
+LioLi::Tree random_tree(const std::string &name, unsigned depth) {
+  static const std::string names[] = {"ip", "port", "addr", "proto", "x",
+                                      "timestamp", "alert", "payload"};
+  LioLi::Tree tree(name);
+
+  for (size_t i = pick(depth ? 5 : 1); i > 0; i--) {
+    if (pick(2)) {
+      tree << random_text();
+    }
+    if (depth && pick(3)) {
+      tree << random_tree(names[pick(std::size(names))], depth - 1);
+    } else {
+      tree << (LioLi::Tree(names[pick(std::size(names))]) << random_text());
+    }
+  }
+  if (pick(2)) {
+    tree << random_text();
+  }
+  return tree;
+}
+
+// The kind of record written by alert_lioli and trout_netflow
+LioLi::Tree typical_tree(unsigned n) {
+  LioLi::Tree tree("$");
+  tree << (LioLi::Tree("timestamp") << "2024-01-02T03:04:05Z") << " "
+       << (LioLi::Tree("protocol") << "TCP") << " "
+       << (LioLi::Tree("principal")
+           << (LioLi::Tree("addr")
+               << (LioLi::Tree("ip") << "10.0.0." + std::to_string(n % 256))
+               << ":" << (LioLi::Tree("port") << 1024 + int(n % 60000))))
+       << " -> "
+       << (LioLi::Tree("endpoint")
+           << (LioLi::Tree("addr") << (LioLi::Tree("ip") << "192.168.1.1")
+                                   << ":" << (LioLi::Tree("port") << 443)))
+       << " " << (LioLi::Tree("bytes") << int(n * 37 % 100000)) << " "
+       << (LioLi::Tree("packets") << int(n % 100));
+  return tree;
+}
+
+std::string write(const std::vector<LioLi::Tree> &trees, bool root_node,
+                  bool sequenced) {
+  std::vector<uint8_t> secret(9, 0x5a);
+  LioLi::LioLi ll;
+
+  ll.set_secret(secret);
+  if (!root_node) {
+    ll.set_no_root_node();
+  }
+  if (sequenced) {
+    ll.set_sequenced();
+  }
+  ll.insert_header();
+  for (size_t i = 0; i < trees.size(); i++) {
+    if (sequenced) {
+      ll.insert_sequence(i * 3);
+    }
+    ll << trees[i];
+  }
+  return ll.move_binary();
+}
+
+bool round_trip(bool root_node, bool sequenced) {
+  std::vector<LioLi::Tree> trees;
+  for (unsigned i = 0; i < 500; i++) {
+    trees.push_back(random_tree("$", 3));
+  }
+  std::string data = write(trees, root_node, sequenced);
+
+  LioLi::Bill::Reader reader(data);
+  LioLi::Bill::Record record;
+  std::vector<LioLi::Tree> read;
+  while (reader.next(record)) {
+    if (sequenced && record.sequence != read.size() * 3) {
+      std::printf("FAIL: wrong sequence %lu\n", record.sequence);
+      return false;
+    }
+    read.push_back(record.to_tree(root_node));
+  }
+
+  if (!reader.is_valid() || reader.get_position() != data.size() ||
+      read.size() != trees.size()) {
+    std::printf("FAIL: read %zu of %zu records\n", read.size(), trees.size());
+    return false;
+  }
+  for (size_t i = 0; i < trees.size(); i++) {
+    if (read[i] != trees[i]) {
+      std::printf("FAIL: record %zu differs\n", i);
+      return false;
+    }
+  }
+  if (write(read, root_node, sequenced) != data) {
+    std::printf("FAIL: written again differs\n");
+    return false;
+  }
+
+  // Same stream arriving in pieces, as from a socket, the consumed part is
+  // dropped from the buffer and a new reader continues the stream
+  std::string buffer;
+  LioLi::Bill::Header header;
+  bool header_read = false;
+  size_t records = 0;
+  for (size_t at = 0; at < data.size();) {
+    size_t chunk = std::min(1 + pick(700), data.size() - at);
+    buffer.append(data, at, chunk);
+    at += chunk;
+
+    LioLi::Bill::Reader piece = header_read
+                                    ? LioLi::Bill::Reader(buffer, header)
+                                    : LioLi::Bill::Reader(buffer);
+    while (piece.next(record)) {
+      if (record.to_tree(root_node) != trees[records++]) {
+        std::printf("FAIL: streamed record %zu differs\n", records - 1);
+        return false;
+      }
+    }
+    if (!piece.is_valid()) {
+      std::printf("FAIL: streamed data rejected\n");
+      return false;
+    }
+    if (piece.get_position() > 0) {
+      header = piece.get_header();
+      header_read = true;
+    }
+    buffer.erase(0, piece.get_position());
+  }
+  if (records != trees.size() || !buffer.empty()) {
+    std::printf("FAIL: streamed %zu of %zu records\n", records, trees.size());
+    return false;
+  }
+
+  // Damaged data must be rejected or read, never read out of bounds
+  for (unsigned i = 0; i < 2000; i++) {
+    std::string damaged = data.substr(0, 16 + pick(data.size() - 16));
+    for (size_t j = pick(4); j > 0; j--) {
+      damaged[16 + pick(damaged.size() - 16)] = static_cast<char>(pick(256));
+    }
+    LioLi::Bill::Reader bad(damaged);
+    while (bad.next(record)) {
+      for (auto &node : record.nodes) {
+        if (node.value.data() < damaged.data() ||
+            node.value.data() + node.value.size() >
+                damaged.data() + damaged.size()) {
+          std::printf("FAIL: node outside of data\n");
+          return false;
+        }
+      }
+    }
+  }
+
+  std::printf("Round trip (%s%s): %zu records OK\n",
+              root_node ? "root node" : "no root node",
+              sequenced ? ", sequenced" : "", trees.size());
+  return true;
+}
+
+// LioLi doesn't write dictionary references (0b00xx'xxxx instead of a name),
+// so they are tested with a handmade record: "ab" with a: [0, 1) and a: [1, 2)
+bool dictionary_names() {
+  std::string data("\x4"
+                   "BILL\0\x2"
+                   "012345678"
+                   "\x2"
+                   "ab"
+                   "\x6"
+                   "\x41\0a\x01"
+                   "\0\x01",
+                   26);
+  LioLi::Bill::Reader reader(data);
+  LioLi::Bill::Record record;
+
+  if (!reader.next(record) || record.nodes.size() != 2 ||
+      record.nodes[1].name != "a" || record.nodes[1].value != "b" ||
+      reader.next(record) || !reader.is_valid()) {
+    std::printf("FAIL: dictionary names\n");
+    return false;
+  }
+
+  std::printf("Dictionary names OK\n");
+  return true;
+}
+
+void benchmark(const char *what, std::string_view data) {
+  LioLi::Bill::Record record;
+  size_t records = 0;
+  size_t nodes = 0;
+  unsigned passes = 0;
+  auto start = std::chrono::steady_clock::now();
+  std::chrono::duration<double> elapsed;
+
+  do {
+    LioLi::Bill::Reader reader(data);
+    while (reader.next(record)) {
+      records++;
+      nodes += record.nodes.size();
+    }
+    if (!reader.is_valid()) {
+      std::printf("%s: malformed at %zu\n", what, reader.get_position());
+      return;
+    }
+    passes++;
+    elapsed = std::chrono::steady_clock::now() - start;
+  } while (elapsed.count() < 1);
+
+  double seconds = elapsed.count();
+  std::printf("%s: %.0f MB/s, %.2f M records/s, %.1f M nodes/s\n", what,
+              data.size() * passes / seconds / 1e6, records / seconds / 1e6,
+              nodes / seconds / 1e6);
+}
+
+bool benchmark_file(const char *path) {
+  int fd = open(path, O_RDONLY);
+  struct stat st;
+  if (fd < 0 || fstat(fd, &st) < 0 || st.st_size == 0) {
+    std::printf("Can't read %s\n", path);
+    return false;
+  }
+
+  void *map = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (map == MAP_FAILED) {
+    std::printf("Can't map %s\n", path);
+    return false;
+  }
+
+  benchmark(path, std::string_view(static_cast<char *>(map), st.st_size));
+  munmap(map, st.st_size);
+  return true;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  if (argc > 1) {
+    bool ok = true;
+    for (int i = 1; i < argc; i++) {
+      ok = benchmark_file(argv[i]) && ok;
+    }
+    return ok ? 0 : 1;
+  }
+
+  if (!round_trip(true, false) || !round_trip(false, false) ||
+      !round_trip(true, true) || !round_trip(false, true) ||
+      !dictionary_names()) {
+    return 1;
+  }
+
+  std::vector<LioLi::Tree> trees;
+  for (unsigned i = 0; i < 100000; i++) {
+    trees.push_back(typical_tree(i));
+  }
+  benchmark("Typical records", write(trees, false, false));
+
+  trees.clear();
+  for (unsigned i = 0; i < 10000; i++) {
+    trees.push_back(random_tree("$", 3));
+  }
+  benchmark("Random records", write(trees, true, false));
+
+  return 0;
+}
@@ -0,0 +1,185 @@
+// Round trip test of LioLi::Columnar, built and run by "make bench". Only
+// uses the LioLi sources, so it doesn't need Snort.
+//
+// Usage: columnar_test
+//   Random trees are written in blocks and read back, every value must come
+//   back in its row and column. The expected file of the trout_netflow
+//   columnar test must be readable (relative to the repository root, where
+//   make runs it), and damaged data rejected without reading out of bounds.
+
+// System includes
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <map>
+#include <random>
+#include <string>
+#include <vector>
+
+// Local includes
+#include "lioli.h"
+#include "lioli_columnar.h"
+
+namespace {
+
+std::mt19937 rng(4711);
+
+size_t pick(size_t n) {
+  return std::uniform_int_distribution<size_t>(0, n - 1)(rng);
+}
+
+// Integers (also ones that must stay strings), repeated and unique strings,
+// so all column encodings are used
+std::string random_value(unsigned kind) {
+  static const std::string values[] = {
+      "0",    "-1",  "00",   "-0",   "007",  "9223372036854775807",
+      "-9223372036854775808", "9223372036854775808", "", "tcp", "udp",
+      "1.5",  "+1",  "1e3"};
+  switch (kind % 4) {
+  case 0:
+    return std::to_string(static_cast<int64_t>(rng()) - (1ll << 31));
+  case 1:
+    return values[pick(std::size(values))];
+  case 2:
+    return pick(2) ? "http" : "dns";
+  default:
+    return std::string(pick(20), static_cast<char>(pick(256)));
+  }
+}
+
+LioLi::Tree random_tree(const std::string &name, unsigned depth,
+                        unsigned kind) {
+  static const std::string names[] = {"ip", "port", "addr", "proto", "x"};
+  LioLi::Tree tree(name);
+
+  for (size_t i = pick(depth ? 4 : 1); i > 0; i--) {
+    if (pick(4) == 0) {
+      tree << random_value(kind);
+    }
+    std::string child = names[pick(std::size(names))];
+    if (depth && pick(3)) {
+      tree << random_tree(child, depth - 1, kind);
+    } else {
+      tree << (LioLi::Tree(child) << random_value(kind + pick(2)));
+    }
+  }
+  return tree;
+}
+
+// Values by path, then row
+using Values = std::map<std::string, std::vector<std::vector<std::string>>>;
+
+void expect(const LioLi::Tree &tree, size_t row, size_t rows,
+            Values &values) {
+  tree.visit_values([&](std::string_view path, std::string_view value) {
+    auto &column = values[std::string(path)];
+    column.resize(rows);
+    column[row].emplace_back(value);
+  });
+}
+
+bool round_trip() {
+  std::string data;
+  std::vector<Values> expected;
+  LioLi::Columnar::Writer writer;
+
+  LioLi::Columnar::Writer::write_header(data);
+  for (unsigned block = 0; block < 200; block++) {
+    size_t rows = 1 + pick(50);
+    expected.emplace_back();
+    for (size_t row = 0; row < rows; row++) {
+      LioLi::Tree tree = random_tree("$", 3, block);
+      expect(tree, row, rows, expected.back());
+      writer.add(tree);
+    }
+    writer.write_block(data);
+  }
+  LioLi::Columnar::Writer::write_end(data);
+
+  LioLi::Columnar::Reader reader(data);
+  LioLi::Columnar::Block block;
+  size_t blocks = 0;
+  while (reader.next(block)) {
+    if (blocks == expected.size()) {
+      std::printf("FAIL: too many blocks\n");
+      return false;
+    }
+
+    Values read;
+    for (auto &column : block.columns) {
+      auto &rows = read[std::string(column.path)];
+      rows.resize(block.rows);
+      size_t value = 0;
+      for (size_t row = 0; row < block.rows; row++) {
+        for (uint32_t i = 0; i < column.counts[row]; i++, value++) {
+          rows[row].push_back(column.integer
+                                  ? std::to_string(column.integers[value])
+                                  : std::string(column.strings[value]));
+        }
+      }
+    }
+    for (auto &[path, rows] : expected[blocks]) {
+      rows.resize(block.rows); // Rows after the last value of the path
+    }
+    if (read != expected[blocks]) {
+      std::printf("FAIL: block %zu differs\n", blocks);
+      return false;
+    }
+    blocks++;
+  }
+
+  if (!reader.is_valid() || blocks != expected.size()) {
+    std::printf("FAIL: read %zu of %zu blocks\n", blocks, expected.size());
+    return false;
+  }
+
+  // Damaged data must be rejected or read, never read out of bounds
+  for (unsigned i = 0; i < 2000; i++) {
+    std::string damaged = data.substr(0, 6 + pick(data.size() - 6));
+    for (size_t j = pick(4); j > 0; j--) {
+      damaged[6 + pick(damaged.size() - 6)] = static_cast<char>(pick(256));
+    }
+    LioLi::Columnar::Reader bad(damaged);
+    while (bad.next(block)) {
+      for (auto &column : block.columns) {
+        for (auto value : column.strings) {
+          if (value.data() < damaged.data() ||
+              value.data() + value.size() > damaged.data() + damaged.size()) {
+            std::printf("FAIL: value outside of data\n");
+            return false;
+          }
+        }
+      }
+    }
+  }
+
+  std::printf("Round trip: %zu blocks OK\n", blocks);
+  return true;
+}
+
+bool expected_file() {
+  const char *path =
+      "plugins/trout_netflow/tests/netflow_columnar_test.expected.col";
+  std::ifstream file(path, std::ios::binary);
+  std::string data((std::istreambuf_iterator<char>(file)),
+                   std::istreambuf_iterator<char>());
+
+  LioLi::Columnar::Reader reader(data);
+  LioLi::Columnar::Block block;
+  size_t rows = 0;
+  while (reader.next(block)) {
+    rows += block.rows;
+  }
+
+  if (!reader.is_valid() || rows == 0) {
+    std::printf("FAIL: %s not readable\n", path);
+    return false;
+  }
+
+  std::printf("%s: %zu rows OK\n", path, rows);
+  return true;
+}
+
+} // namespace
+
+int main() { return round_trip() && expected_file() ? 0 : 1; }
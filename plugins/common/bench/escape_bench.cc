@@ -0,0 +1,226 @@
+// Cross check and benchmark of the LioLi::Escape implementations, built and
+// run by "make bench". Only uses the LioLi sources, so it doesn't need Snort.
+//
+// Usage: escape_bench [file.pcap ...]
+//   The AVX2, SSE2 and scalar implementations (those the CPU can run) are
+//   checked against each other on random and boundary length input, then
+//   their throughput is measured on the TCP payloads of the pcaps. Without
+//   arguments the HTTP pcap of the alert_lioli tests is used (relative to
+//   the repository root, where make runs it).
+
+// System includes
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <random>
+#include <string>
+#include <vector>
+
+// Local includes
+#include "lioli_escape.h"
+
+namespace {
+
+using LioLi::Escape::Implementation;
+using LioLi::Escape::Set;
+
+std::mt19937 rng(4711);
+
+size_t pick(size_t n) {
+  return std::uniform_int_distribution<size_t>(0, n - 1)(rng);
+}
+
+size_t find(const Implementation &implementation, std::string_view data,
+            Set set) {
+  return set == Set::lorth ? implementation.lorth(data.data(), data.size())
+                           : implementation.json(data.data(), data.size());
+}
+
+// Reference, straight from the definition of the sets
+size_t find_reference(std::string_view data, Set set) {
+  for (size_t pos = 0; pos < data.size(); pos++) {
+    unsigned char c = data[pos];
+    bool lorth = c == '\n' || c == '\t' || c == '\r';
+    bool json = c == '\\' || c < 0x20 || c >= 0x80;
+    if (c == '"' || (set == Set::lorth ? lorth : json)) {
+      return pos;
+    }
+  }
+  return data.size();
+}
+
+bool agree(std::string_view data, const char *what) {
+  for (Set set : {Set::lorth, Set::json}) {
+    // Also from an odd offset, so the loads aren't aligned
+    for (size_t offset = 0; offset < 2 && offset <= data.size(); offset++) {
+      std::string_view view = data.substr(offset);
+      size_t expected = find_reference(view, set);
+
+      for (auto &implementation : LioLi::Escape::implementations()) {
+        if (find(implementation, view, set) != expected) {
+          std::printf("FAIL: %s differs for %s input of %zu bytes\n",
+                      implementation.name, what, view.size());
+          return false;
+        }
+      }
+    }
+  }
+  return true;
+}
+
+bool cross_check() {
+  // Every byte value at every position around the vector widths
+  for (size_t size : {1, 15, 16, 17, 31, 32, 33, 47, 48, 63, 64, 65, 97}) {
+    for (size_t pos = 0; pos < size; pos++) {
+      for (unsigned c = 0; c < 256; c++) {
+        std::string data(size, 'a');
+        data[pos] = static_cast<char>(c);
+        if (!agree(data, "boundary")) {
+          return false;
+        }
+      }
+    }
+  }
+
+  // Random data, from clean to dense with special bytes
+  for (unsigned i = 0; i < 200000; i++) {
+    std::string data(pick(200), 'a');
+    size_t density = pick(4) == 0 ? 0 : 1 + pick(8);
+    for (auto &c : data) {
+      c = static_cast<char>(pick(64) < density ? pick(256) : ' ' + pick(95));
+    }
+    if (!agree(data, "random")) {
+      return false;
+    }
+  }
+
+  std::printf("Cross check OK:");
+  for (auto &implementation : LioLi::Escape::implementations()) {
+    std::printf(" %s", implementation.name);
+  }
+  std::printf("\n");
+  return true;
+}
+
+uint32_t read32(const std::string &data, size_t at) {
+  return uint8_t(data[at]) | uint8_t(data[at + 1]) << 8 |
+         uint8_t(data[at + 2]) << 16 | uint32_t(uint8_t(data[at + 3])) << 24;
+}
+
+uint16_t read16_be(const std::string &data, size_t at) {
+  return uint8_t(data[at]) << 8 | uint8_t(data[at + 1]);
+}
+
+// TCP payloads of a little endian, Ethernet pcap (as the ones in the repo)
+bool read_payloads(const char *path, std::vector<std::string> &payloads) {
+  std::ifstream file(path, std::ios::binary);
+  std::string data((std::istreambuf_iterator<char>(file)),
+                   std::istreambuf_iterator<char>());
+
+  if (data.size() < 24 || read32(data, 0) != 0xa1b2c3d4 ||
+      read32(data, 20) != 1) {
+    std::printf("Can't read %s\n", path);
+    return false;
+  }
+
+  for (size_t at = 24; at + 16 <= data.size();) {
+    size_t length = read32(data, at + 8);
+    size_t frame = at + 16;
+    at = frame + length;
+    if (at > data.size() || length < 14) {
+      break;
+    }
+
+    size_t ip = frame + 14;
+    uint16_t type = read16_be(data, frame + 12);
+    if (type == 0x8100 && length >= 18) { // VLAN
+      type = read16_be(data, frame + 16);
+      ip += 4;
+    }
+
+    size_t tcp;
+    size_t end;
+    if (type == 0x0800 && ip + 20 <= at && data[ip + 9] == 6) {
+      tcp = ip + (data[ip] & 0x0f) * 4;
+      end = std::min<size_t>(at, ip + read16_be(data, ip + 2));
+    } else if (type == 0x86dd && ip + 40 <= at && data[ip + 6] == 6) {
+      tcp = ip + 40;
+      end = std::min<size_t>(at, tcp + read16_be(data, ip + 4));
+    } else {
+      continue;
+    }
+
+    if (tcp + 20 <= end) {
+      size_t payload = tcp + (uint8_t(data[tcp + 12]) >> 4) * 4;
+      if (payload < end) {
+        payloads.push_back(data.substr(payload, end - payload));
+      }
+    }
+  }
+
+  return true;
+}
+
+// Scans every payload to its end, as a serializer escaping it does
+void benchmark(const std::vector<std::string> &payloads, size_t bytes) {
+  for (Set set : {Set::lorth, Set::json}) {
+    for (auto &implementation : LioLi::Escape::implementations()) {
+      size_t specials = 0;
+      unsigned passes = 0;
+      auto start = std::chrono::steady_clock::now();
+      std::chrono::duration<double> elapsed;
+
+      do {
+        for (auto &payload : payloads) {
+          std::string_view rest(payload);
+          while (!rest.empty()) {
+            size_t pos = find(implementation, rest, set);
+            if (pos < rest.size()) {
+              specials++;
+              pos++;
+            }
+            rest.remove_prefix(pos);
+          }
+        }
+        passes++;
+        elapsed = std::chrono::steady_clock::now() - start;
+      } while (elapsed.count() < 0.5);
+
+      std::printf("%s %s: %.0f MB/s, %zu escapes per pass\n",
+                  set == Set::lorth ? "lorth" : "json", implementation.name,
+                  bytes * passes / elapsed.count() / 1e6, specials / passes);
+    }
+  }
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  if (!cross_check()) {
+    return 1;
+  }
+
+  std::vector<const char *> paths(argv + 1, argv + argc);
+  if (paths.empty()) {
+    paths.push_back("plugins/alert_lioli/tests/pcaps/google_http.pcap");
+  }
+
+  std::vector<std::string> payloads;
+  for (auto path : paths) {
+    if (!read_payloads(path, payloads)) {
+      return 1;
+    }
+  }
+
+  size_t bytes = 0;
+  for (auto &payload : payloads) {
+    bytes += payload.size();
+  }
+  std::printf("%zu TCP payloads, %zu bytes\n", payloads.size(), bytes);
+
+  if (bytes) {
+    benchmark(payloads, bytes);
+  }
+  return 0;
+}
@@ -0,0 +1,122 @@
+// Tests of LioLi::ReplayWindow, the resumable delivery of logger_pipe, built
+// and run by "make bench". Only uses the LioLi sources, so it doesn't need
+// Snort.
+//
+// Usage: replay_window_test
+
+// System includes
+#include <cstdio>
+#include <string>
+#include <vector>
+
+// Local includes
+#include "replay_window.h"
+
+namespace {
+
+bool check(bool ok, const char *what) {
+  if (!ok) {
+    std::printf("FAIL: %s\n", what);
+  }
+  return ok;
+}
+
+// Writes n records, the data of a record is its sequence number
+void write(LioLi::ReplayWindow &window, unsigned n,
+           std::vector<uint64_t> *stream = nullptr) {
+  for (unsigned i = 0; i < n; i++) {
+    uint64_t sequence = window.next_sequence();
+    window.add(sequence, std::to_string(sequence) + " ");
+    if (stream) {
+      stream->push_back(sequence);
+    }
+  }
+}
+
+bool ack_and_window() {
+  LioLi::ReplayWindow window(4);
+
+  bool ok = check(window.next_sequence() == 1, "first sequence number");
+  window.add(1, "1 ");
+  write(window, 5);
+  ok = check(window.size() == 4, "window size") && ok;
+
+  // 1 and 2 are pushed out, so resuming after 1 leaves a gap
+  ok = check(window.resume(1) == 3, "gap after window") && ok;
+  ok = check(window.take_replay() == "3 4 5 6 ", "replay of window") && ok;
+
+  window.ack(4);
+  ok = check(window.size() == 2, "ack") && ok;
+  ok = check(window.resume(4) == 5, "resume after ack") && ok;
+  ok = check(window.take_replay() == "5 6 ", "replay after ack") && ok;
+
+  // Nothing to replay, the next record is the first one sent
+  window.ack(6);
+  ok = check(window.resume(6) == 7, "resume when all acked") && ok;
+  ok = check(window.take_replay().empty(), "empty replay") && ok;
+
+  window.set_max_records(1);
+  write(window, 3);
+  ok = check(window.size() == 1, "window shrunk") && ok;
+
+  if (ok) {
+    std::printf("Ack and window OK\n");
+  }
+  return ok;
+}
+
+// Mirrors the worker of logger_pipe: records are written to a stream that
+// breaks now and then, losing what the consumer hasn't read. The consumer
+// must see every record in order, without duplicates, if it resumes after
+// each reconnect
+bool reconnects() {
+  LioLi::ReplayWindow window(1000);
+  std::vector<uint64_t> stream;
+  std::vector<uint64_t> received;
+  bool ok = true;
+
+  window.hold(); // First opening of the pipe
+  for (unsigned round = 0; round < 50; round++) {
+    uint64_t last = received.empty() ? 0 : received.back();
+
+    // Trees queued while the consumer connects must wait for its resume
+    if (!check(window.is_holding() && !window.has_replay(), "not holding")) {
+      return false;
+    }
+    window.resume(last);
+
+    // Replay first, then new records
+    std::string replay = window.take_replay();
+    for (size_t at = 0; at < replay.size();) {
+      size_t end = replay.find(' ', at);
+      stream.push_back(std::stoull(replay.substr(at, end - at)));
+      at = end + 1;
+    }
+    write(window, 1 + round % 7, &stream);
+
+    // The consumer reads part of the stream, the rest is lost when the
+    // stream breaks
+    size_t read = stream.size() * (round % 4) / 4;
+    for (size_t i = 0; i < read; i++) {
+      if (!received.empty() && stream[i] != received.back() + 1) {
+        ok = check(false, "records out of order or duplicated");
+      }
+      received.push_back(stream[i]);
+    }
+    stream.clear();
+    window.ack(received.empty() ? 0 : received.back());
+    window.hold();
+  }
+
+  ok = check(window.resume(received.back()) == received.back() + 1,
+             "unacked records kept") &&
+       ok;
+  if (ok) {
+    std::printf("Reconnects OK, %zu records received\n", received.size());
+  }
+  return ok;
+}
+
+} // namespace
+
+int main() { return ack_and_window() && reconnects() ? 0 : 1; }
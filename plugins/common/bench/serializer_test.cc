@@ -0,0 +1,164 @@
+// Tests of the tree serializations of LioLi::Tree, built and run by
+// "make bench". Only uses the LioLi sources, so it doesn't need Snort.
+//
+// Usage: serializer_test
+//   The expected files of the alert_lioli serializer tests are checked
+//   against the LioLi code: the trees of the BILL expectation (written by
+//   the plugin) are read back and serialized again in the other formats.
+//   Paths are relative to the repository root, where make runs it.
+
+// System includes
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+// Local includes
+#include "lioli.h"
+#include "lioli_bill.h"
+
+namespace {
+
+const std::string fixtures = "plugins/alert_lioli/tests/";
+
+bool read_file(const std::string &path, std::string &data) {
+  std::ifstream file(path, std::ios::binary);
+  if (!file) {
+    std::printf("FAIL: can't read %s\n", path.c_str());
+    return false;
+  }
+  data.assign(std::istreambuf_iterator<char>(file),
+              std::istreambuf_iterator<char>());
+  return true;
+}
+
+bool read_trees(std::vector<LioLi::Tree> &trees) {
+  std::string data;
+  if (!read_file(fixtures + "alert_test_bill.expected.bill", data)) {
+    return false;
+  }
+
+  LioLi::Bill::Reader reader(data);
+  LioLi::Bill::Record record;
+  while (reader.next(record)) {
+    trees.push_back(record.to_tree(true));
+  }
+  if (!reader.is_valid() || trees.empty()) {
+    std::printf("FAIL: BILL expectation not readable\n");
+    return false;
+  }
+  return true;
+}
+
+std::string as_json(const LioLi::Tree &tree) {
+  std::string output;
+  tree.append_json(output);
+  return output;
+}
+
+std::string as_cbor(const LioLi::Tree &tree) {
+  std::string output;
+  tree.append_cbor(output);
+  return output;
+}
+
+bool matches(const std::string &output, const std::string &file) {
+  std::string expected;
+  if (!read_file(fixtures + file, expected)) {
+    return false;
+  }
+  if (output != expected) {
+    std::printf("FAIL: output differs from %s\n", file.c_str());
+    return false;
+  }
+  std::printf("%s OK\n", file.c_str());
+  return true;
+}
+
+bool json(const std::vector<LioLi::Tree> &trees) {
+  std::string output;
+  for (auto &tree : trees) {
+    tree.append_json(output);
+  }
+  return matches(output, "alert_test_json.expected.json");
+}
+
+// Siblings sharing a name become one array, at the first of them, both for
+// a few siblings and for the many that are grouped by hashing
+bool json_siblings() {
+  LioLi::Tree few("$");
+  few << "x" << (LioLi::Tree("a") << "1") << (LioLi::Tree("b") << "2")
+      << (LioLi::Tree("a") << "3") << "y";
+
+  LioLi::Tree many("$");
+  std::string expected = "{";
+  for (unsigned i = 0; i < 40; i++) {
+    std::string name = "n";
+    many << (LioLi::Tree(name += std::to_string(i % 20)) << std::to_string(i));
+  }
+  for (unsigned i = 0; i < 20; i++) {
+    expected += i ? ",\"n" : "\"n";
+    expected += std::to_string(i) + "\":[\"" + std::to_string(i) + "\",\"" +
+                std::to_string(i + 20) + "\"]";
+  }
+  expected += "}\n";
+
+  if (as_json(few) != "{\"$text\":[\"x\",\"y\"],\"a\":[\"1\",\"3\"],"
+                       "\"b\":\"2\"}\n" ||
+      as_json(many) != expected) {
+    std::printf("FAIL: JSON siblings\n");
+    return false;
+  }
+  std::printf("JSON siblings OK\n");
+  return true;
+}
+
+bool cbor(const std::vector<LioLi::Tree> &trees) {
+  std::string output;
+  for (auto &tree : trees) {
+    tree.append_cbor(output);
+  }
+  return matches(output, "alert_test_cbor.expected.cbor");
+}
+
+// A memoized node is spliced in from its cache once serialized, also as an
+// array item or after other members, the output must not change
+bool memoized() {
+  LioLi::Tree rule("rule");
+  rule << (LioLi::Tree("gid") << "1") << ":" << (LioLi::Tree("sid") << "2");
+  LioLi::Tree cached = rule;
+  cached.memoize();
+
+  LioLi::Tree plain("$");
+  LioLi::Tree spliced("$");
+  for (unsigned i = 0; i < 3; i++) {
+    plain << "x" << rule << (LioLi::Tree("n") << "3");
+    spliced << "x" << cached << (LioLi::Tree("n") << "3");
+  }
+  LioLi::Tree single("$");
+  single << (LioLi::Tree("n") << "3") << cached;
+
+  // Twice, the first fills the cache
+  for (unsigned i = 0; i < 2; i++) {
+    if (as_json(spliced) != as_json(plain) ||
+        as_cbor(spliced) != as_cbor(plain) ||
+        as_json(single) != "{\"n\":\"3\",\"rule\":{\"gid\":\"1\","
+                           "\"$text\":\":\",\"sid\":\"2\"}}\n") {
+      std::printf("FAIL: memoized node serialized differently\n");
+      return false;
+    }
+  }
+  std::printf("Memoized nodes OK\n");
+  return true;
+}
+
+} // namespace
+
+int main() {
+  std::vector<LioLi::Tree> trees;
+
+  bool ok = read_trees(trees) && json(trees) && json_siblings() &&
+            cbor(trees) && memoized();
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,198 @@
+
+// Snort includes
+
+// System includes
+#include <bit>
+#include <cstring>
+
+// Local includes
+#include "digest.h"
+
+// Debug includes
+
+namespace Common {
+namespace {
+
+uint32_t read32be(const uint8_t *p) {
+  return (uint32_t(p[0]) << 24) | (uint32_t(p[1]) << 16) |
+         (uint32_t(p[2]) << 8) | p[3];
+}
+
+uint32_t read32le(const char *p) {
+  const auto *b = reinterpret_cast<const uint8_t *>(p);
+  return b[0] | (uint32_t(b[1]) << 8) | (uint32_t(b[2]) << 16) |
+         (uint32_t(b[3]) << 24);
+}
+
+uint64_t read64le(const char *p) {
+  return read32le(p) | (uint64_t(read32le(p + 4)) << 32);
+}
+
+constexpr uint32_t sha256_k[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1,
+    0x923f82a4, 0xab1c5ed5, 0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3,
+    0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174, 0xe49b69c1, 0xefbe4786,
+    0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147,
+    0x06ca6351, 0x14292967, 0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13,
+    0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85, 0xa2bfe8a1, 0xa81a664b,
+    0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a,
+    0x5b9cca4f, 0x682e6ff3, 0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208,
+    0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2};
+
+void sha256_block(uint32_t state[8], const uint8_t *block) {
+  uint32_t w[64];
+
+  for (size_t i = 0; i < 16; i++) {
+    w[i] = read32be(block + i * 4);
+  }
+  for (size_t i = 16; i < 64; i++) {
+    uint32_t s0 = std::rotr(w[i - 15], 7) ^ std::rotr(w[i - 15], 18) ^
+                  (w[i - 15] >> 3);
+    uint32_t s1 = std::rotr(w[i - 2], 17) ^ std::rotr(w[i - 2], 19) ^
+                  (w[i - 2] >> 10);
+    w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+  }
+
+  uint32_t a = state[0], b = state[1], c = state[2], d = state[3];
+  uint32_t e = state[4], f = state[5], g = state[6], h = state[7];
+
+  for (size_t i = 0; i < 64; i++) {
+    uint32_t s1 = std::rotr(e, 6) ^ std::rotr(e, 11) ^ std::rotr(e, 25);
+    uint32_t ch = (e & f) ^ (~e & g);
+    uint32_t t1 = h + s1 + ch + sha256_k[i] + w[i];
+    uint32_t s0 = std::rotr(a, 2) ^ std::rotr(a, 13) ^ std::rotr(a, 22);
+    uint32_t maj = (a & b) ^ (a & c) ^ (b & c);
+    uint32_t t2 = s0 + maj;
+
+    h = g;
+    g = f;
+    f = e;
+    e = d + t1;
+    d = c;
+    c = b;
+    b = a;
+    a = t1 + t2;
+  }
+
+  state[0] += a;
+  state[1] += b;
+  state[2] += c;
+  state[3] += d;
+  state[4] += e;
+  state[5] += f;
+  state[6] += g;
+  state[7] += h;
+}
+
+} // namespace
+
+std::array<uint8_t, 32> sha256(std::string_view data) {
+  uint32_t state[8] = {0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
+                       0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19};
+  const auto *p = reinterpret_cast<const uint8_t *>(data.data());
+  size_t size = data.size();
+
+  for (; size >= 64; p += 64, size -= 64) {
+    sha256_block(state, p);
+  }
+
+  // The rest, 0x80, zeros and the length in bits, in one or two blocks
+  uint8_t last[128] = {};
+  std::memcpy(last, p, size);
+  last[size] = 0x80;
+
+  size_t blocks = size < 56 ? 1 : 2;
+  uint64_t bits = uint64_t(data.size()) * 8;
+  for (size_t i = 0; i < 8; i++) {
+    last[blocks * 64 - 1 - i] = static_cast<uint8_t>(bits >> (i * 8));
+  }
+  for (size_t i = 0; i < blocks; i++) {
+    sha256_block(state, last + i * 64);
+  }
+
+  std::array<uint8_t, 32> digest;
+  for (size_t i = 0; i < 8; i++) {
+    digest[i * 4] = static_cast<uint8_t>(state[i] >> 24);
+    digest[i * 4 + 1] = static_cast<uint8_t>(state[i] >> 16);
+    digest[i * 4 + 2] = static_cast<uint8_t>(state[i] >> 8);
+    digest[i * 4 + 3] = static_cast<uint8_t>(state[i]);
+  }
+  return digest;
+}
+
+uint64_t xxh64(std::string_view data, uint64_t seed) {
+  constexpr uint64_t prime1 = 11400714785074694791ull;
+  constexpr uint64_t prime2 = 14029467366897019727ull;
+  constexpr uint64_t prime3 = 1609587929392839161ull;
+  constexpr uint64_t prime4 = 9650029242287828579ull;
+  constexpr uint64_t prime5 = 2870177450012600261ull;
+
+  auto round = [](uint64_t acc, uint64_t lane) {
+    return std::rotl(acc + lane * prime2, 31) * prime1;
+  };
+  auto merge = [&round](uint64_t hash, uint64_t acc) {
+    return (hash ^ round(0, acc)) * prime1 + prime4;
+  };
+
+  const char *p = data.data();
+  const char *end = p + data.size();
+  uint64_t hash;
+
+  if (data.size() >= 32) {
+    uint64_t v1 = seed + prime1 + prime2;
+    uint64_t v2 = seed + prime2;
+    uint64_t v3 = seed;
+    uint64_t v4 = seed - prime1;
+
+    for (; end - p >= 32; p += 32) {
+      v1 = round(v1, read64le(p));
+      v2 = round(v2, read64le(p + 8));
+      v3 = round(v3, read64le(p + 16));
+      v4 = round(v4, read64le(p + 24));
+    }
+
+    hash = std::rotl(v1, 1) + std::rotl(v2, 7) + std::rotl(v3, 12) +
+           std::rotl(v4, 18);
+    hash = merge(hash, v1);
+    hash = merge(hash, v2);
+    hash = merge(hash, v3);
+    hash = merge(hash, v4);
+  } else {
+    hash = seed + prime5;
+  }
+
+  hash += data.size();
+
+  for (; end - p >= 8; p += 8) {
+    hash = std::rotl(hash ^ round(0, read64le(p)), 27) * prime1 + prime4;
+  }
+  if (end - p >= 4) {
+    hash = std::rotl(hash ^ (read32le(p) * prime1), 23) * prime2 + prime3;
+    p += 4;
+  }
+  for (; p < end; p++) {
+    hash = std::rotl(hash ^ (static_cast<uint8_t>(*p) * prime5), 11) * prime1;
+  }
+
+  hash ^= hash >> 33;
+  hash *= prime2;
+  hash ^= hash >> 29;
+  hash *= prime3;
+  hash ^= hash >> 32;
+  return hash;
+}
+
+void append_hex(std::string_view data, std::string &out) {
+  static const char digits[] = "0123456789abcdef";
+
+  size_t at = out.size();
+  out.resize(at + data.size() * 2);
+  for (auto c : data) {
+    out[at++] = digits[static_cast<uint8_t>(c) >> 4];
+    out[at++] = digits[static_cast<uint8_t>(c) & 15];
+  }
+}
+
+} // namespace Common
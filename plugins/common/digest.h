@@ -0,0 +1,31 @@
+#ifndef digest_5be0d9a4
+#define digest_5be0d9a4
+
+// Snort includes
+
+// System includes
+#include <array>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+// Local includes
+
+// Global includes
+
+// Debug includes
+
+namespace Common {
+
+// SHA-256 (FIPS 180-4)
+std::array<uint8_t, 32> sha256(std::string_view data);
+
+// XXH64, as specified by the xxHash project
+uint64_t xxh64(std::string_view data, uint64_t seed = 0);
+
+// Appends data as lower case hex digits to out
+void append_hex(std::string_view data, std::string &out);
+
+} // namespace Common
+
+#endif // #ifndef digest_5be0d9a4
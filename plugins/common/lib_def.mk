@@ -11,12 +11,24 @@ PUBLIC_INC := .
 # List source (.cc) files that should be included in the build
 CC_FILES := \
 	dictionary.cc \
+	digest.cc \
 	lioli.cc \
+	lioli_bill.cc \
+	lioli_block_codec.cc \
+	lioli_columnar.cc \
+	lioli_escape.cc \
 	lioli_path.cc \
+	replay_window.cc \
 
 H_FILES = \
 	dictionary.h \
+	digest.h \
 	lioli.h \
+	lioli_bill.h \
+	lioli_block_codec.h \
+	lioli_columnar.h \
+	lioli_escape.h \
 	lioli_path.h \
 	lioli_tree_generator.h \
+	replay_window.h \
 	testable_time.h
@@ -2,12 +2,18 @@
 // Snort includes
 
 // System includes
+#include <algorithm>
 #include <cassert>
+#include <charconv>
 #include <iostream>
+#include <iterator>
+#include <mutex>
 #include <regex>
+#include <unordered_map>
 
 // Local includes
 #include "lioli.h"
+#include "lioli_escape.h"
 #include "lioli_path.h"
 
 // Debug includes
@@ -34,20 +40,12 @@ public:
 
 class LorthHelpers {
 public:
-  static std::string escape(std::string &&in) {
-    // Chars that should be escaped
-    const static std::string esc("\"\n\t\r");
+  // Appends in to out, with the chars lorth can't hold in a string escaped
+  static void escape(std::string &out, std::string_view in) {
+    size_t spos = 0;
+    size_t sfind = Escape::find(in, Escape::Set::lorth);
 
-    std::string::size_type spos = 0;
-    std::string::size_type sfind = in.find_first_of(esc);
-
-    // Bail if nothing to do
-    if (in.npos == sfind)
-      return in;
-
-    std::string outstring;
-
-    do {
+    while (sfind != in.size()) {
       char replacer;
       switch (in[sfind]) {
       case '\"':
@@ -64,38 +62,387 @@ public:
         break;
       default:
         assert(false); // We don't know how to replace
+        replacer = in[sfind];
       }
 
-      outstring +=
-          in.substr(spos, sfind - spos); // note, we don't add 1, as the pos we
-                                         // found shouldn't be copied
-      outstring += '\\';
-      outstring += replacer;
+      // note, we don't add 1, as the pos we found shouldn't be copied
+      out.append(in, spos, sfind - spos);
+      out += '\\';
+      out += replacer;
       spos = sfind + 1;
-      sfind = in.find_first_of(esc, spos);
-    } while (in.npos != sfind);
+      sfind = spos + Escape::find(in.substr(spos), Escape::Set::lorth);
+    }
 
     // Copy reminder of string
-    outstring += in.substr(spos);
+    out.append(in, spos);
+  }
+};
+
+class JsonHelpers {
+public:
+  // Member holding text not covered by a child, as '$' can't start a node
+  // name (except the root) it can't clash with a child
+  constexpr static std::string_view text_key = "$text";
+
+  // Returns the length of the valid UTF-8 sequence starting at pos, 0 if the
+  // bytes there aren't valid UTF-8 (overlong, surrogate or truncated)
+  static size_t utf8_length(std::string_view in, size_t pos) {
+    auto byte = [&](size_t offset) -> unsigned {
+      return pos + offset < in.size()
+                 ? static_cast<unsigned char>(in[pos + offset])
+                 : 0;
+    };
+    auto in_range = [](unsigned value, unsigned low, unsigned high) {
+      return value >= low && value <= high;
+    };
+
+    unsigned lead = byte(0);
+    if (in_range(lead, 0xc2, 0xdf)) {
+      return in_range(byte(1), 0x80, 0xbf) ? 2 : 0;
+    }
+
+    // Second byte range is limited for some leads, to rule out overlong
+    // sequences, surrogates and code points above U+10FFFF
+    unsigned low = 0x80;
+    unsigned high = 0xbf;
+    size_t length;
+    if (in_range(lead, 0xe0, 0xef)) {
+      length = 3;
+      low = lead == 0xe0 ? 0xa0 : low;
+      high = lead == 0xed ? 0x9f : high;
+    } else if (in_range(lead, 0xf0, 0xf4)) {
+      length = 4;
+      low = lead == 0xf0 ? 0x90 : low;
+      high = lead == 0xf4 ? 0x8f : high;
+    } else {
+      return 0;
+    }
+
+    if (!in_range(byte(1), low, high)) {
+      return 0;
+    }
+    for (size_t i = 2; i < length; i++) {
+      if (!in_range(byte(i), 0x80, 0xbf)) {
+        return 0;
+      }
+    }
+    return length;
+  }
+
+  // Appends in to out as a JSON string. Bytes that aren't valid UTF-8 are
+  // written as \u00XX (i.e. read as Latin-1), so no data is lost
+  static void escape(std::string &out, std::string_view in) {
+    constexpr static char hex[] = "0123456789abcdef";
+
+    out += '"';
+
+    size_t spos = 0;
+    size_t sfind = Escape::find(in, Escape::Set::json);
+
+    while (sfind != in.size()) {
+      out.append(in, spos, sfind - spos);
+
+      unsigned char c = in[sfind];
+      size_t length = c >= 0x80 ? utf8_length(in, sfind) : 0;
+
+      if (length) {
+        out.append(in, sfind, length); // Valid UTF-8, copied as is
+      } else {
+        length = 1;
+        switch (c) {
+        case '"':
+          out += "\\\"";
+          break;
+        case '\\':
+          out += "\\\\";
+          break;
+        case '\n':
+          out += "\\n";
+          break;
+        case '\t':
+          out += "\\t";
+          break;
+        case '\r':
+          out += "\\r";
+          break;
+        case '\b':
+          out += "\\b";
+          break;
+        case '\f':
+          out += "\\f";
+          break;
+        default:
+          out += "\\u00";
+          out += hex[c >> 4];
+          out += hex[c & 0xf];
+        }
+      }
+
+      spos = sfind + length;
+      sfind = spos + Escape::find(in.substr(spos), Escape::Set::json);
+    }
+
+    // Copy reminder of string
+    out.append(in, spos);
+    out += '"';
+  }
+};
+
+// Writers used with Tree::Node::walk_object()
+class JsonWriter {
+  std::string &out;
+
+  // Members and array items are separated by ',', set when one has been
+  // written at the current level, cleared by the bracket or key starting
+  // the next value
+  bool pending_comma = false;
+
+  void separate() {
+    if (pending_comma) {
+      out += ',';
+      pending_comma = false;
+    }
+  }
+
+public:
+  static constexpr Tree::Encoding encoding = Tree::Encoding::json;
+
+  JsonWriter(std::string &out) : out(out) {}
+
+  // Start of a value that can be kept and spliced in somewhere else, without
+  // the separator before it
+  size_t mark() {
+    separate();
+    return out.size();
+  }
+  std::string_view since(size_t mark) const {
+    return std::string_view(out).substr(mark);
+  }
+  void splice(std::string_view value) {
+    separate();
+    out += value;
+    pending_comma = true;
+  }
+
+  void begin_object(size_t) {
+    separate();
+    out += '{';
+  }
+  void end_object() {
+    out += '}';
+    pending_comma = true;
+  }
+
+  void begin_array(size_t) {
+    separate();
+    out += '[';
+  }
+  void end_array() {
+    out += ']';
+    pending_comma = true;
+  }
 
-    return outstring;
+  void key(std::string_view name) {
+    separate();
+    out += '"';
+    out += name; // Node names never need escaping
+    out += "\":";
+  }
+
+  void text(std::string_view value) {
+    separate();
+    JsonHelpers::escape(out, value);
+    pending_comma = true;
+  }
+  void leaf(std::string_view value) { text(value); }
+};
+
+class CborWriter {
+  std::string &out;
+
+  enum Major : uint8_t {
+    unsigned_int = 0,
+    negative_int = 1,
+    byte_string = 2,
+    text_string = 3,
+    array = 4,
+    map = 5,
+  };
+
+  // Initial byte and argument, in the shortest form
+  void head(Major major, uint64_t value) {
+    uint8_t type = major << 5;
+    unsigned bytes;
+
+    if (value < 24) {
+      out += static_cast<char>(type | value);
+      return;
+    } else if (value <= 0xff) {
+      out += static_cast<char>(type | 24);
+      bytes = 1;
+    } else if (value <= 0xffff) {
+      out += static_cast<char>(type | 25);
+      bytes = 2;
+    } else if (value <= 0xffff'ffff) {
+      out += static_cast<char>(type | 26);
+      bytes = 4;
+    } else {
+      out += static_cast<char>(type | 27);
+      bytes = 8;
+    }
+
+    // Big endian
+    while (bytes--) {
+      out += static_cast<char>(value >> (bytes * 8));
+    }
+  }
+
+  static bool is_utf8(std::string_view value) {
+    size_t pos = Escape::find(value, Escape::Set::json);
+
+    while (pos != value.size()) {
+      size_t length = 1;
+      if (static_cast<unsigned char>(value[pos]) >= 0x80) {
+        length = JsonHelpers::utf8_length(value, pos);
+        if (!length) {
+          return false;
+        }
+      }
+      pos += length;
+      pos += Escape::find(value.substr(pos), Escape::Set::json);
+    }
+
+    return true;
+  }
+
+  // Decimal integers without leading zeros that fit in a CBOR integer, so
+  // converting back to text gives the original value
+  bool integer(std::string_view value) {
+    bool negative = !value.empty() && value[0] == '-';
+    std::string_view digits = value.substr(negative);
+
+    if (digits.empty() || digits.size() > 20 ||
+        (digits[0] == '0' && (digits.size() > 1 || negative))) {
+      return false;
+    }
+
+    uint64_t number;
+    auto [ptr, ec] =
+        std::from_chars(digits.data(), digits.data() + digits.size(), number);
+    if (ec != std::errc() || ptr != digits.data() + digits.size()) {
+      return false;
+    }
+
+    if (negative) {
+      head(negative_int, number - 1); // -1 - n is encoded as n
+    } else {
+      head(unsigned_int, number);
+    }
+    return true;
+  }
+
+public:
+  static constexpr Tree::Encoding encoding = Tree::Encoding::cbor;
+
+  CborWriter(std::string &out) : out(out) {}
+
+  size_t mark() const { return out.size(); }
+  std::string_view since(size_t mark) const {
+    return std::string_view(out).substr(mark);
+  }
+  void splice(std::string_view value) { out += value; }
+
+  void begin_object(size_t members) { head(map, members); }
+  void end_object() {}
+
+  void begin_array(size_t items) { head(array, items); }
+  void end_array() {}
+
+  void key(std::string_view name) {
+    head(text_string, name.size());
+    out += name;
+  }
+
+  void text(std::string_view value) {
+    head(is_utf8(value) ? text_string : byte_string, value.size());
+    out += value;
+  }
+
+  void leaf(std::string_view value) {
+    if (!integer(value)) {
+      text(value);
+    }
   }
 };
 
 } // namespace
 
-void Tree::Node::set_end(size_t new_end) { end = new_end; }
+// Serialized forms of a memoized node. Copies of a tree share it, and they
+// can be serialized by different threads
+class Tree::Cache {
+  struct Entry {
+    bool valid = false;
+    unsigned level = 0; // Indentation (lorth only)
+    std::string data;
+  };
+
+  std::mutex mutex;
+  Entry entries[3]; // Indexed by Encoding
+
+public:
+  // Calls use with the kept data, returns false if there is none
+  template <typename Use>
+  bool use(Encoding encoding, unsigned level, Use &&use) {
+    std::scoped_lock lock(mutex);
+    auto &entry = entries[static_cast<size_t>(encoding)];
+
+    if (!entry.valid || entry.level != level) {
+      return false;
+    }
+    use(std::string_view(entry.data));
+    return true;
+  }
+
+  void keep(Encoding encoding, unsigned level, std::string_view data) {
+    std::scoped_lock lock(mutex);
+    auto &entry = entries[static_cast<size_t>(encoding)];
+
+    entry.valid = true;
+    entry.level = level;
+    entry.data = data;
+  }
+};
+
+void Tree::Node::invalidate() {
+  // Other copies still have the old content, so they keep the old cache
+  if (cache) {
+    cache = std::make_shared<Cache>();
+  }
+}
+
+void Tree::Node::memoize() {
+  if (!cache) {
+    cache = std::make_shared<Cache>();
+  }
+}
+
+void Tree::Node::set_end(size_t new_end) {
+  end = new_end;
+  invalidate();
+}
 
 void Tree::Node::add_as_child(const Node &node) {
   last_child_added = children.emplace_after(last_child_added, node);
   last_child_added->adjust(end);
   end = last_child_added->end;
+  invalidate();
 }
 
 void Tree::Node::add_as_child(Node &&node) {
   last_child_added = children.insert_after(last_child_added, std::move(node));
   last_child_added->adjust(end);
   end = last_child_added->end;
+  invalidate();
 }
 
 // Copy version of append
@@ -110,13 +457,14 @@ void Tree::Node::append(const Node &node) {
     assert(false);
   }
 
-  for (auto child_node : node.children) {
+  for (const auto &child_node : node.children) {
     last_child_added = children.emplace_after(last_child_added, child_node);
     // Adjust the newly created child trees start and end
     last_child_added->adjust(end);
   }
 
   end += node.end;
+  invalidate();
 }
 
 // Move version of append
@@ -145,12 +493,15 @@ void Tree::Node::append(Node &&node) {
   // Clean up last fields of node
   node.start = 0;
   node.end = 0;
+
+  invalidate();
 }
 
 Tree::Node::Node(){};
 
 Tree::Node::Node(const Node &p)
-    : my_name(p.my_name), start(p.start), end(p.end), children(p.children) {
+    : my_name(p.my_name), start(p.start), end(p.end), children(p.children),
+      cache(p.cache) {
   last_child_added = children.before_begin();
 
   auto tmp = last_child_added;
@@ -169,6 +520,7 @@ Tree::Node::Node(Node &&src) {
   src.end = 0;
   children = std::move(src.children);
   src.children.clear();
+  cache = std::move(src.cache);
 
   // The before begin iterator is specific to a given forward list, but
   // iterators to elements that are moved, points to the moved elements
@@ -193,54 +545,254 @@ void Tree::Node::adjust(size_t delta) {
   }
 }
 
-std::string Tree::Node::dump_string(const std::string &raw,
-                                    unsigned level) const {
-  std::string output;
-  output.insert(0, level, '-');
-
-  output += my_name + ": ";
-
-  output += raw.substr(start, end - start);
-
-  output += "\n";
+void Tree::Node::write_string(std::string &out, const std::string &raw,
+                              unsigned level) const {
+  out.append(level, '-');
+  out += my_name;
+  out += ": ";
+  out.append(raw, start, end - start);
+  out += '\n';
 
   for (auto &child : children) {
-    output += child.dump_string(raw, level + 1);
+    child.write_string(out, raw, level + 1);
   }
-  return output;
 }
 
-std::string Tree::Node::dump_lorth(const std::string &raw,
-                                   unsigned level) const {
-  std::string output;
-  std::string spacer;
-  spacer.insert(0, level, ' ');
+void Tree::Node::write_lorth(std::string &out, const std::string &raw,
+                             unsigned level) const {
+  if (cache) {
+    auto splice = [&out](std::string_view data) { out += data; };
+    if (cache->use(Encoding::lorth, level, splice)) {
+      return;
+    }
+  }
+  size_t mark = out.size();
 
-  output += spacer;
-  output += my_name + " ";
+  // Text between children is written as is, only leaf values are escaped
+  auto write_text = [&](size_t from, size_t to) {
+    out.append(level, ' ');
+    out += " \"";
+    out.append(raw, from, to - from);
+    out += "\" .\n";
+  };
+
+  out.append(level, ' ');
+  out += my_name;
+  out += ' ';
 
   if (!children.empty()) {
-    output += "{\n";
+    out += "{\n";
 
     size_t ep = start;
     for (auto &child : children) {
       if (ep != child.start) {
-        output += spacer + " \"" + raw.substr(ep, child.start - ep) + "\" .\n";
+        write_text(ep, child.start);
       }
-      output += child.dump_lorth(raw, level + 1);
+      child.write_lorth(out, raw, level + 1);
       ep = child.end;
     }
     if (ep != end) {
-      output += spacer + " \"" + raw.substr(ep, end - ep) + "\" .\n";
+      write_text(ep, end);
+    }
+    out.append(level, ' ');
+    out += "}\n";
+  } else {
+    out += '"';
+    LorthHelpers::escape(out, std::string_view(raw).substr(start, end - start));
+    out += "\" .\n";
+  }
+
+  if (cache) {
+    cache->keep(Encoding::lorth, level, std::string_view(out).substr(mark));
+  }
+}
+
+template <typename Writer>
+void Tree::Node::walk_value(Writer &writer, const std::string &raw) const {
+  // A memoized leaf keeps its value too, e.g. an escaped message
+  if (cache) {
+    auto splice = [&writer](std::string_view data) { writer.splice(data); };
+    if (cache->use(Writer::encoding, 0, splice)) {
+      return;
     }
-    output += spacer + "}\n";
+  }
+  size_t mark = writer.mark();
+
+  if (children.empty()) {
+    writer.leaf(std::string_view(raw).substr(start, end - start));
   } else {
+    walk_object(writer, raw);
+  }
 
-    output +=
-        "\"" + LorthHelpers::escape(raw.substr(start, end - start)) + "\" .\n";
+  if (cache) {
+    cache->keep(Writer::encoding, 0, writer.since(mark));
   }
+}
 
-  return output;
+template <typename Writer>
+void Tree::Node::walk_object(Writer &writer, const std::string &raw) const {
+  std::string_view view(raw);
+
+  // Text not covered by a child, all runs go into a single member
+  unsigned runs = 0;
+  size_t ep = start;
+  for (auto &child : children) {
+    runs += ep != child.start;
+    ep = child.end;
+  }
+  runs += ep != end;
+
+  auto walk_text = [&]() {
+    writer.key(JsonHelpers::text_key);
+
+    if (runs > 1) {
+      writer.begin_array(runs);
+    }
+    size_t tp = start;
+    for (auto &child : children) {
+      if (tp != child.start) {
+        writer.text(view.substr(tp, child.start - tp));
+      }
+      tp = child.end;
+    }
+    if (tp != end) {
+      writer.text(view.substr(tp, end - tp));
+    }
+    if (runs > 1) {
+      writer.end_array();
+    }
+  };
+
+  // Siblings sharing a name are written together, where the first of them
+  // is. Each child links to the next one with its name, the first of them
+  // holds the size of the group. Found in one pass, by hashing the names
+  // unless there are only a few children (as for most nodes). The links of
+  // nested objects are stacked on the same vector, so it is only allocated
+  // while it grows
+  struct Link {
+    const Node *node;
+    uint32_t first;
+    uint32_t next; // 0 for the last of a name
+    uint32_t count;
+  };
+  static thread_local std::vector<Link> stack;
+  const size_t base = stack.size();
+  auto links = [base](uint32_t index) -> Link & { return stack[base + index]; };
+
+  constexpr uint32_t few = 16;
+  std::unordered_map<std::string_view, uint32_t> last; // Index by name
+  uint32_t size = 0;
+
+  size_t members = runs > 0;
+  for (auto &child : children) {
+    uint32_t index = size++;
+    uint32_t previous = index;
+
+    if (index < few) {
+      for (uint32_t i = index; i-- > 0;) {
+        if (links(i).node->my_name == child.my_name) {
+          previous = i;
+          break;
+        }
+      }
+    } else {
+      if (index == few) {
+        for (uint32_t i = 0; i < few; i++) {
+          last[links(i).node->my_name] = i;
+        }
+      }
+      auto [itr, added] = last.try_emplace(child.my_name, index);
+      if (!added) {
+        previous = itr->second;
+        itr->second = index;
+      }
+    }
+
+    if (previous == index) {
+      stack.push_back({&child, index, 0, 1});
+      members++;
+    } else {
+      stack.push_back({&child, links(previous).first, 0, 0});
+      links(previous).next = index;
+      links(links(previous).first).count++;
+    }
+  }
+
+  writer.begin_object(members);
+
+  bool text_written = false;
+  ep = start;
+  for (uint32_t index = 0; index < size; index++) {
+    // Copied, the stack grows while the children are walked
+    const Link link = links(index);
+
+    if (ep != link.node->start && !text_written) {
+      walk_text();
+      text_written = true;
+    }
+    ep = link.node->end;
+
+    // Siblings sharing a name were written along with the first of them
+    if (link.first != index) {
+      continue;
+    }
+
+    writer.key(link.node->my_name);
+
+    if (link.count == 1) {
+      link.node->walk_value(writer, raw);
+      continue;
+    }
+
+    writer.begin_array(link.count);
+    uint32_t next = index;
+    do {
+      links(next).node->walk_value(writer, raw);
+      next = links(next).next;
+    } while (next);
+    writer.end_array();
+  }
+  stack.resize(base);
+
+  if (runs > 0 && !text_written) {
+    walk_text();
+  }
+
+  writer.end_object();
+}
+
+void Tree::Node::visit_values(std::string &path, const std::string &raw,
+                              const ValueVisitor &visit,
+                              bool as_object) const {
+  std::string_view view(raw);
+
+  if (children.empty() && !as_object) {
+    visit(path, view.substr(start, end - start));
+    return;
+  }
+
+  size_t length = path.size();
+  auto visit_text = [&](size_t from, size_t to) {
+    path += '.';
+    path += JsonHelpers::text_key;
+    visit(path, view.substr(from, to - from));
+    path.resize(length);
+  };
+
+  size_t ep = start;
+  for (auto &child : children) {
+    if (ep != child.start) {
+      visit_text(ep, child.start);
+    }
+    path += '.';
+    path += child.my_name;
+    child.visit_values(path, raw, visit);
+    path.resize(length);
+    ep = child.end;
+  }
+  if (ep != end) {
+    visit_text(ep, end);
+  }
 }
 
 std::string Tree::Node::dump_binary(size_t delta, bool add_root_node) const {
@@ -310,6 +862,60 @@ std::string Tree::Node::dump_binary(size_t delta, bool add_root_node) const {
   return output;
 }
 
+const Tree::Node *Tree::Node::find_child(std::string_view name) const {
+  for (auto &child : children) {
+    if (child.my_name == name) {
+      return &child;
+    }
+  }
+  return nullptr;
+}
+
+size_t Tree::Node::count_children() const {
+  return std::distance(children.begin(), children.end());
+}
+
+bool Tree::Node::split(size_t count, size_t pos, Node &head,
+                       Node &tail) const {
+  assert(head.children.empty() && tail.children.empty());
+
+  if (pos < start || pos > end) {
+    return false;
+  }
+
+  head.my_name = my_name;
+  head.start = start;
+  head.end = pos;
+  head.last_child_added = head.children.before_begin();
+
+  tail.my_name = my_name;
+  tail.start = 0;
+  tail.end = end - pos;
+  tail.last_child_added = tail.children.before_begin();
+
+  size_t next = pos; // Children added follow each other, with nothing between
+  for (auto &child : children) {
+    if (count > 0) {
+      if (child.end > pos) {
+        return false;
+      }
+      head.last_child_added =
+          head.children.emplace_after(head.last_child_added, child);
+      count--;
+    } else {
+      if (child.start != next) {
+        return false;
+      }
+      next = child.end;
+      tail.last_child_added =
+          tail.children.emplace_after(tail.last_child_added, child);
+      tail.last_child_added->adjust(-pos); // Wraps, so it moves back by pos
+    }
+  }
+
+  return count == 0 && next == end;
+}
+
 bool Tree::Node::is_valid(size_t start, size_t end) const {
   if (this->start < start || this->end > end) {
     return false;
@@ -332,7 +938,9 @@ Tree::Tree(const std::string &name) : me(name) {
   assert(Path::is_valid_node_name(name));
 }
 
-Tree &Tree::operator<<(const std::string &text) {
+Tree &Tree::operator<<(const std::string &text) { return add_text(text); }
+
+Tree &Tree::add_text(std::string_view text) {
   assert(is_valid());
 
   raw += text;
@@ -414,14 +1022,92 @@ bool Tree::operator==(const Tree &tree) const {
   return 0 == tree.as_string().compare(as_string());
 }
 
-std::string Tree::as_string() const { return me.dump_string(raw); }
+std::string Tree::as_string() const {
+  std::string output;
+  append_string(output);
+  return output;
+}
 
 std::string Tree::as_lorth() const {
-  std::string output = me.dump_lorth(raw);
-  output = output.substr(0, output.length() - 1) + ";\n";
+  std::string output;
+  append_lorth(output);
   return output;
 }
 
+void Tree::append_string(std::string &out) const { me.write_string(out, raw); }
+
+void Tree::append_lorth(std::string &out) const {
+  me.write_lorth(out, raw);
+
+  // The tree is terminated by ';' placed before the final newline
+  assert(out.back() == '\n');
+  out.back() = ';';
+  out += '\n';
+}
+
+void Tree::append_json(std::string &out) const {
+  JsonWriter writer(out);
+  me.walk_object(writer, raw);
+  out += '\n';
+}
+
+void Tree::append_cbor(std::string &out) const {
+  CborWriter writer(out);
+  me.walk_object(writer, raw);
+}
+
+Tree &Tree::memoize() {
+  me.memoize();
+  return *this;
+}
+
+void Tree::mark_template() {
+  template_mark = TemplateMark{me.count_children(), raw.size(),
+                               std::make_shared<const std::string>(as_lorth())};
+}
+
+bool Tree::split_template(Tree &head, Tree &tail) const {
+  if (!template_mark ||
+      !me.split(template_mark->children, template_mark->size, head.me,
+                tail.me)) {
+    return false;
+  }
+
+  head.raw = raw.substr(0, template_mark->size);
+  head.template_mark.reset();
+  tail.raw = raw.substr(template_mark->size);
+  tail.template_mark.reset();
+
+  assert(head.is_valid() && tail.is_valid());
+  return true;
+}
+
+void Tree::visit_values(const ValueVisitor &visit) const {
+  std::string path = me.get_name();
+  me.visit_values(path, raw, visit, true);
+}
+
+std::optional<std::string_view> Tree::get_value(std::string_view path) const {
+  size_t pos = path.find('.');
+
+  // First element of the path must be the root node
+  if (path.substr(0, pos) != me.get_name()) {
+    return std::nullopt;
+  }
+
+  const Node *node = &me;
+  while (pos != std::string_view::npos) {
+    size_t next = path.find('.', pos + 1);
+    node = node->find_child(path.substr(pos + 1, next - pos - 1));
+    if (!node) {
+      return std::nullopt;
+    }
+    pos = next;
+  }
+
+  return node->get_value(raw);
+}
+
 bool Tree::is_valid() const {
   size_t rs = raw.size();
 
@@ -431,12 +1117,17 @@ bool Tree::is_valid() const {
 LioLi::LioLi() {}
 
 void LioLi::insert_header() {
-  ss << '\x4' << "BILL" << '\x0' << '\x2';
+  ss << '\x4' << "BILL" << '\x0' << (sequenced ? '\x3' : '\x2');
   for (int i = 0; i < 9; i++) {
     ss << secret[i];
   }
 }
 
+void LioLi::insert_sequence(uint64_t sequence) {
+  assert(sequenced);
+  Binary::as_varint(ss, sequence);
+}
+
 void LioLi::insert_terminator() {
   // BILL02 format does not use terminators
 }
@@ -7,8 +7,12 @@
 #include <cassert>
 #include <cstdint>
 #include <forward_list>
+#include <functional>
+#include <memory>
+#include <optional>
 #include <sstream>
 #include <string>
+#include <string_view>
 #include <vector>
 
 // Local includes
@@ -17,12 +21,23 @@ namespace LioLi {
 
 class LioLi;
 
+// Called with the absolute path (e.g. "$.principal.addr.ip") and value
+using ValueVisitor =
+    std::function<void(std::string_view path, std::string_view value)>;
+
 // A tree is a tree of nodes, even you can build a tree by adding one
 // tree to another, the result does not consists of the two trees.
 // A tree is a self contained entity, it has a single string with all
 // the data it contains, and a node tree that names specific substrings
 // of the main string in a tree structure
 class Tree {
+public:
+  // Serialized forms a memoized node keeps, see memoize()
+  enum class Encoding : uint8_t { lorth, json, cbor };
+
+private:
+  class Cache;
+
   class Node {
     std::string my_name;
     size_t start = 0;
@@ -31,7 +46,12 @@ class Tree {
     std::forward_list<Node>::iterator last_child_added =
         children.before_begin();
 
+    // Shared by all copies of the node, replaced when the node changes. Only
+    // set for memoized nodes
+    std::shared_ptr<Cache> cache;
+
     void adjust(size_t delta);
+    void invalidate();
 
     void recalc_last_child() {
       auto next_child = children.before_begin();
@@ -56,11 +76,39 @@ class Tree {
     void append(const Node &node);
     void append(Node &&node);
 
-    void set_name(const std::string &new_name) { my_name = new_name; }
+    void set_name(const std::string &new_name) {
+      my_name = new_name;
+      invalidate();
+    }
+    void memoize();
     const std::string &get_name() const { return my_name; }
 
-    std::string dump_string(const std::string &raw, unsigned level = 0) const;
-    std::string dump_lorth(const std::string &raw, unsigned level = 0) const;
+    // Returns first child with the given name, nullptr if there is none
+    const Node *find_child(std::string_view name) const;
+    size_t count_children() const;
+    // Splits the node in its first count children (ending at pos) and the
+    // rest, head and tail must be empty. Returns false if a child crosses pos
+    // or the rest isn't only children (e.g. text was added to the node)
+    bool split(size_t count, size_t pos, Node &head, Node &tail) const;
+    std::string_view get_value(const std::string &raw) const {
+      return std::string_view(raw).substr(start, end - start);
+    }
+
+    // Append the node to out, so a whole tree is written into one buffer
+    void write_string(std::string &out, const std::string &raw,
+                      unsigned level = 0) const;
+    void write_lorth(std::string &out, const std::string &raw,
+                     unsigned level = 0) const;
+    // Walks the node in the object model shared by JSON and CBOR (see
+    // Tree::append_json()), leaves are values, other nodes are objects
+    template <typename Writer>
+    void walk_value(Writer &writer, const std::string &raw) const;
+    template <typename Writer>
+    void walk_object(Writer &writer, const std::string &raw) const;
+
+    // path holds the path of this node, it is restored before returning
+    void visit_values(std::string &path, const std::string &raw,
+                      const ValueVisitor &visit, bool as_object = false) const;
     std::string dump_binary(size_t delta, bool add_root_node) const;
 
     // For debug/test
@@ -71,6 +119,16 @@ class Tree {
 
   std::string raw; // The raw string (e.i. the string referenced by the tree)
 
+  // Set by mark_template()
+  struct TemplateMark {
+    size_t children; // Number of children of the root in the template
+    size_t size;     // Size of raw data in the template
+    // The template as lorth, shared by all copies of the tree, so it is only
+    // serialized once
+    std::shared_ptr<const std::string> key;
+  };
+  std::optional<TemplateMark> template_mark;
+
 public:
   Tree();
   Tree(const std::string &name);
@@ -83,6 +141,9 @@ public:
   Tree &operator<<(const Tree &tree);
   Tree &operator<<(Tree &&tree);
 
+  // As << text, for text that isn't in a string
+  Tree &add_text(std::string_view text);
+
   void merge(const Tree &tree, bool node_merge = false);
   void merge(Tree &&tree, bool node_merge = false);
 
@@ -90,14 +151,69 @@ public:
   bool operator!=(const Tree &tree) const { return !(*this == tree); }
 
   void set_root_name(const std::string &new_name) { me.set_name(new_name); }
+
+  // Makes the root keep its serialized forms (lorth, JSON and CBOR), shared
+  // by all copies, so a subtree added to many trees (e.g. the addresses of a
+  // flow) is only serialized once. Changing the tree drops what was kept
+  Tree &memoize();
   const std::string &get_root_name() const { return me.get_name(); }
+
+  // Returns the data of the node found by following the absolute path (e.g.
+  // "$.principal.addr.ip"), on each level the first child with a matching
+  // name is used. The view is only valid as long as the tree isn't modified
+  std::optional<std::string_view> get_value(std::string_view path) const;
   std::string as_string() const;
   std::string as_lorth() const;
 
+  // As as_string()/as_lorth(), but appends to out, so the caller can reuse
+  // its buffer between trees
+  void append_string(std::string &out) const;
+  void append_lorth(std::string &out) const;
+
+  // Appends the tree as one line of JSON (NDJSON). The root is an object,
+  // children become members and repeated sibling names become an array at
+  // the position of the first one. Text not covered by a child is put in a
+  // "$text" member (an array if there is more than one run of text)
+  void append_json(std::string &out) const;
+
+  // Appends the tree as one CBOR (RFC 8949) map, using the same model as
+  // append_json(). Leaves that are decimal integers are typed as integers,
+  // leaves that aren't valid UTF-8 as byte strings
+  void append_cbor(std::string &out) const;
+
+  // Marks everything added so far as the template of the tree, the part that
+  // stays the same between records (e.g. of a flow). Only children may be
+  // added after this. Templated serializer contexts send the template once,
+  // and only the rest of the tree with every record, others ignore the mark.
+  // The mark is copied with the tree, so mark a tree that is copied for each
+  // record rather than each copy
+  void mark_template();
+  bool has_template() const { return template_mark.has_value(); }
+
+  // Identifies the template of a marked tree, the same for the same template
+  const std::string &get_template_key() const {
+    assert(template_mark);
+    return *template_mark->key;
+  }
+
+  // Splits a marked tree into the template and the children added after
+  // marking, both get the name of the root. Returns false if the tree isn't
+  // marked or was changed in another way than adding children (e.g. text was
+  // added to the root), the tree must then be sent in full
+  bool split_template(Tree &head, Tree &tail) const;
+
+  // Calls visit for every leaf, in tree order. Text not covered by a child is
+  // visited with the path of its parent plus ".$text", the same model as
+  // append_json()
+  void visit_values(const ValueVisitor &visit) const;
+
   uint32_t hash() const {
     return raw.length();
   } // Very fast and simple hash function
 
+  // Bytes of text held by the tree
+  size_t size() const { return raw.size(); }
+
   // For Debug
   bool is_valid() const; // Checks if the tree is valid
 
@@ -111,6 +227,7 @@ class LioLi {
   std::stringstream ss;
   std::vector<uint8_t> secret;
   bool add_root_node = true;
+  bool sequenced = false;
 
 public:
   LioLi();
@@ -118,6 +235,10 @@ public:
   void insert_terminator();
   std::string move_binary();
   void set_no_root_node() { add_root_node = false; }
+  // Every tree will be preceded by a sequence number (BILL03), must be set
+  // before the header is inserted
+  void set_sequenced() { sequenced = true; }
+  void insert_sequence(uint64_t sequence);
   void set_secret(std::vector<uint8_t> &secret) {
     assert(secret.size() == 9); // There are exactly 9 bytes in a secret
     this->secret = secret;
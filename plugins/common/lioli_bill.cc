@@ -0,0 +1,286 @@
+
+// Snort includes
+
+// System includes
+#include <cassert>
+
+// Local includes
+#include "lioli_bill.h"
+
+// Debug includes
+
+namespace LioLi {
+namespace Bill {
+namespace {
+
+constexpr std::string_view magic("\x4"
+                                 "BILL\0",
+                                 6);
+constexpr size_t header_size = magic.size() + 1 + 9; // + version + secret
+
+// Written instead of a raw length to end a stream
+constexpr uint64_t terminator = UINT64_MAX;
+
+// Adds the text and children of nodes[index] to tree, returns the index after
+// the subtree
+size_t fill(const Record &record, size_t index, Tree &tree) {
+  const Node &node = record.nodes[index];
+  size_t at = node.offset;
+  size_t end = node.offset + node.value.size();
+
+  for (index++; index < node.next;) {
+    const Node &child = record.nodes[index];
+    if (child.offset > at) {
+      tree << std::string(record.raw.substr(at, child.offset - at));
+    }
+    at = child.offset + child.value.size();
+
+    Tree subtree{std::string(child.name)};
+    index = fill(record, index, subtree);
+    tree << std::move(subtree);
+  }
+  if (end > at) {
+    tree << std::string(record.raw.substr(at, end - at));
+  }
+
+  return index;
+}
+
+} // namespace
+
+Tree Record::to_tree(bool root_node, const std::string &root_name) const {
+  if (root_node) {
+    assert(!nodes.empty() && nodes[0].next == nodes.size());
+
+    Tree tree{std::string(nodes[0].name)};
+    fill(*this, 0, tree);
+    return tree;
+  }
+
+  Tree tree(root_name);
+  size_t at = 0;
+  for (size_t index = 0; index < nodes.size();) {
+    if (nodes[index].offset > at) {
+      tree << std::string(raw.substr(at, nodes[index].offset - at));
+    }
+    at = nodes[index].offset + nodes[index].value.size();
+
+    Tree subtree{std::string(nodes[index].name)};
+    index = fill(*this, index, subtree);
+    tree << std::move(subtree);
+  }
+  if (raw.size() > at) {
+    tree << std::string(raw.substr(at));
+  }
+  return tree;
+}
+
+Reader::Reader(std::string_view data) : data(data) {}
+
+Reader::Reader(std::string_view data, const Header &header)
+    : data(data), header_read(true), header(header) {}
+
+bool Reader::read_header() {
+  if (data.size() < header_size) {
+    return false; // Wait for more data
+  }
+
+  uint8_t version = data[magic.size()];
+  if (data.substr(0, magic.size()) != magic || version < 2 || version > 3) {
+    valid = false;
+    return false;
+  }
+
+  header.version = version;
+  for (size_t i = 0; i < header.secret.size(); i++) {
+    header.secret[i] = data[magic.size() + 1 + i];
+  }
+
+  pos = header_size;
+  header_read = true;
+  return true;
+}
+
+bool Reader::read_varint(size_t &at, uint64_t &value) const {
+  value = 0;
+
+  for (unsigned shift = 0; shift < 64; shift += 7) {
+    if (at >= data.size()) {
+      return false;
+    }
+    uint8_t digit = data[at++];
+    value |= static_cast<uint64_t>(digit & 0b0111'1111) << shift;
+    if (!(digit & 0b1000'0000)) {
+      return true;
+    }
+  }
+
+  return false; // More than 10 bytes
+}
+
+// See Tree::Node::dump_binary for the encoding. Nodes are parsed without
+// recursion, as the nesting depth is only limited by the data
+bool Reader::parse_tree(std::string_view tree, Record &record) {
+  auto &nodes = record.nodes;
+  const auto *bytes = reinterpret_cast<const uint8_t *>(tree.data());
+  size_t size = tree.size();
+  size_t at = 0;
+  size_t next_start = 0; // Where the next top level node starts
+
+  nodes.clear();
+  names.clear();
+  open.clear();
+
+  while (at < size || !open.empty()) {
+    // Close the nodes that have all their children
+    if (!open.empty() && at == open.back().end) {
+      nodes[open.back().node].next = nodes.size();
+      open.pop_back();
+      continue;
+    }
+
+    size_t end = open.empty() ? size : open.back().end;
+    size_t &delta = open.empty() ? next_start : open.back().next_start;
+
+    // Subtree length, only present for nodes with children
+    bool has_children = bytes[at] & 0b1000'0000;
+    size_t node_end = 0;
+    if (has_children) {
+      if (end - at < 2) {
+        return false;
+      }
+      node_end = at + 2 + ((bytes[at] & 0b0111'1111) | (bytes[at + 1] << 7));
+      at += 2;
+      if (node_end > end || node_end == at) {
+        return false;
+      }
+    }
+
+    // Name, either a literal or an earlier name of the record
+    if (at == end) {
+      return false;
+    }
+    std::string_view name;
+    if ((bytes[at] & 0b1100'0000) == 0b0100'0000) {
+      if (end - at < 2) {
+        return false;
+      }
+      size_t length = (bytes[at] & 0b0011'1111) | (bytes[at + 1] << 6);
+      at += 2;
+      if (length > end - at) {
+        return false;
+      }
+      name = tree.substr(at, length);
+      names.push_back(name);
+      at += length;
+    } else if ((bytes[at] & 0b1100'0000) == 0) {
+      size_t index = bytes[at++];
+      if (index >= names.size()) {
+        return false;
+      }
+      name = names[index];
+    } else {
+      return false;
+    }
+
+    // Position, relative to the parent start or the previous sibling end
+    if (at == end) {
+      return false;
+    }
+    size_t skip;
+    size_t length;
+    if (!(bytes[at] & 0b1000'0000)) {
+      skip = bytes[at] >> 4;
+      length = bytes[at] & 0b0000'1111;
+      at += 1;
+    } else if (!(bytes[at] & 0b0100'0000)) {
+      if (end - at < 2) {
+        return false;
+      }
+      skip = bytes[at] & 0b0011'1111;
+      length = bytes[at + 1];
+      at += 2;
+    } else {
+      if (end - at < 4) {
+        return false;
+      }
+      skip = (bytes[at] & 0b0011'1111) | (bytes[at + 1] << 6);
+      length = bytes[at + 2] | (bytes[at + 3] << 8);
+      at += 4;
+    }
+
+    // Children must be within their parent
+    size_t start = delta + skip;
+    size_t limit = open.empty() ? record.raw.size()
+                                : nodes[open.back().node].offset +
+                                      nodes[open.back().node].value.size();
+    if (start > limit || length > limit - start) {
+      return false;
+    }
+    delta = start + length;
+
+    nodes.push_back({name, record.raw.substr(start, length), start,
+                     static_cast<uint32_t>(open.size()),
+                     static_cast<uint32_t>(nodes.size() + 1)});
+
+    if (has_children) {
+      if (at >= node_end) {
+        return false; // Children announced, but none present
+      }
+      open.push_back({nodes.size() - 1, node_end, start});
+    }
+  }
+
+  return true;
+}
+
+bool Reader::next(Record &record) {
+  if (!valid || ended || (!header_read && !read_header())) {
+    return false;
+  }
+
+  size_t at = pos;
+  uint64_t sequence = 0;
+  uint64_t raw_size;
+  uint64_t tree_size;
+
+  // Running out of data is not an error, the rest may not have arrived
+  if ((header.is_sequenced() && !read_varint(at, sequence)) ||
+      !read_varint(at, raw_size)) {
+    valid = at == data.size(); // Otherwise too long
+    return false;
+  }
+  if (raw_size == terminator) {
+    pos = at;
+    ended = true;
+    return false;
+  }
+  if (raw_size > data.size() - at) {
+    return false;
+  }
+  std::string_view raw = data.substr(at, raw_size);
+  at += raw_size;
+
+  if (!read_varint(at, tree_size)) {
+    valid = at == data.size();
+    return false;
+  }
+  if (tree_size > data.size() - at) {
+    return false;
+  }
+  std::string_view tree = data.substr(at, tree_size);
+  at += tree_size;
+
+  record.sequence = sequence;
+  record.raw = raw;
+  if (!parse_tree(tree, record)) {
+    valid = false;
+    return false;
+  }
+
+  pos = at;
+  return true;
+}
+
+} // namespace Bill
+} // namespace LioLi
@@ -0,0 +1,102 @@
+#ifndef lioli_bill_2c8e47b1
+#define lioli_bill_2c8e47b1
+
+// Snort includes
+
+// System includes
+#include <array>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Local includes
+#include "lioli.h"
+
+// Debug includes
+
+namespace LioLi {
+namespace Bill {
+
+struct Header {
+  uint8_t version = 2; // 3 = sequenced (BILL03)
+  std::array<uint8_t, 9> secret = {};
+
+  bool is_sequenced() const { return version == 3; }
+};
+
+// Nodes of a record are stored depth first, so the children of nodes[i] are
+// the nodes from i + 1 up to (excluding) nodes[i].next
+struct Node {
+  std::string_view name;
+  std::string_view value; // Data covered by the node, children included
+  size_t offset;          // Offset of value in the raw data of the record
+  uint32_t depth;         // Top level nodes have depth 0
+  uint32_t next;          // Index after the last node of the subtree
+};
+
+struct Record {
+  uint64_t sequence = 0;   // Only set in sequenced streams
+  std::string_view raw;    // The data all nodes point into
+  std::vector<Node> nodes; // Reused between records
+
+  // Rebuilds the record as a tree (copying the data). With root_node the
+  // record must have a single top level node, which becomes the root,
+  // otherwise the top level nodes are added to a root named root_name (as
+  // written with option_no_root_node)
+  Tree to_tree(bool root_node, const std::string &root_name = "$") const;
+};
+
+// Reads a BILL stream as written by LioLi::LioLi. The views in the records
+// point into the data given to the reader (e.g. a memory mapped file or a
+// socket buffer), so it must outlive them. Nothing is copied
+class Reader {
+  std::string_view data;
+  size_t pos = 0;
+  bool header_read = false;
+  bool valid = true;
+  bool ended = false;
+  Header header;
+
+  // Names of the current record, dictionary entries refer to them by index
+  std::vector<std::string_view> names;
+  // Nodes whose children are being parsed, reused between records
+  struct Open {
+    size_t node;
+    size_t end;        // End of the node in the tree data
+    size_t next_start; // Where the next child starts in the raw data
+  };
+  std::vector<Open> open;
+
+  bool read_header();
+  bool read_varint(size_t &at, uint64_t &value) const;
+  bool parse_tree(std::string_view tree, Record &record);
+
+public:
+  // data must begin with the stream header
+  Reader(std::string_view data);
+
+  // data continues a stream after its header, e.g. the rest of a socket
+  // buffer from where get_position() of the previous reader stopped
+  Reader(std::string_view data, const Header &header);
+
+  // Returns false at the end of the stream, when data ends within a record
+  // (more data is needed, continue from get_position()) or if the data is
+  // malformed, in which case is_valid() returns false
+  bool next(Record &record);
+
+  bool is_valid() const { return valid; }
+
+  // True if the end of stream marker has been read
+  bool is_ended() const { return ended; }
+
+  // Bytes of data consumed, the header and all complete records
+  size_t get_position() const { return pos; }
+
+  const Header &get_header() const { return header; }
+};
+
+} // namespace Bill
+} // namespace LioLi
+
+#endif // lioli_bill_2c8e47b1
@@ -0,0 +1,414 @@
+
+// Snort includes
+
+// System includes
+#include <algorithm>
+#include <bit>
+#include <cassert>
+#include <cstring>
+
+// Local includes
+#include "lioli_block_codec.h"
+
+// Debug includes
+
+namespace LioLi {
+namespace BlockCodec {
+namespace {
+
+constexpr std::string_view magic("LZBK\0\1", 6);
+
+// LZ4 block format limits
+constexpr size_t min_match = 4;
+constexpr size_t last_literals = 5; // Last bytes of a block are literals
+constexpr size_t match_limit = 12;  // Last match starts this far from the end
+constexpr size_t max_offset = 65535;
+
+uint32_t read32(const char *p) {
+  uint32_t value;
+  std::memcpy(&value, p, sizeof(value));
+  return value; // Only used for hashing and equality, so endian doesn't matter
+}
+
+uint32_t read32le(const char *p) {
+  auto u = reinterpret_cast<const unsigned char *>(p);
+  return u[0] | (u[1] << 8) | (u[2] << 16) | (uint32_t(u[3]) << 24);
+}
+
+// Same encoding as BILL (and GO varints)
+void write_varint(std::string &out, uint64_t number) {
+  do {
+    uint8_t digit = number & 0b0111'1111;
+    number >>= 7;
+    if (number)
+      digit |= 0b1000'0000;
+    out += static_cast<char>(digit);
+  } while (number);
+}
+
+bool read_varint(std::string_view data, size_t &pos, uint64_t &value) {
+  value = 0;
+
+  for (unsigned shift = 0; shift < 64; shift += 7) {
+    if (pos >= data.size()) {
+      return false;
+    }
+    uint8_t digit = data[pos++];
+    value |= static_cast<uint64_t>(digit & 0b0111'1111) << shift;
+    if (!(digit & 0b1000'0000)) {
+      return true;
+    }
+  }
+
+  return false; // More than 10 bytes
+}
+
+// Lengths of 15 and above continue in extra bytes
+void write_length(std::string &out, size_t length) {
+  for (length -= 15; length >= 255; length -= 255) {
+    out += static_cast<char>(255);
+  }
+  out += static_cast<char>(length);
+}
+
+bool read_length(std::string_view in, size_t &ip, size_t &length) {
+  uint8_t byte;
+  do {
+    if (ip >= in.size()) {
+      return false;
+    }
+    byte = in[ip++];
+    length += byte;
+  } while (byte == 255);
+  return true;
+}
+
+void write_sequence(std::string &out, std::string_view literals,
+                    size_t offset, size_t match_length) {
+  size_t token_pos = out.size();
+  uint8_t token = std::min<size_t>(literals.size(), 15) << 4;
+  out += '\0';
+
+  if (literals.size() >= 15) {
+    write_length(out, literals.size());
+  }
+  out += literals;
+
+  if (match_length) {
+    out += static_cast<char>(offset);
+    out += static_cast<char>(offset >> 8);
+
+    match_length -= min_match;
+    token |= std::min<size_t>(match_length, 15);
+    if (match_length >= 15) {
+      write_length(out, match_length);
+    }
+  }
+
+  out[token_pos] = token;
+}
+
+} // namespace
+
+void lz4_compress(std::string_view in, std::string &out, unsigned level,
+                  std::vector<uint32_t> &table) {
+  assert(level >= min_level && level <= max_level);
+
+  const char *data = in.data();
+  size_t size = in.size();
+
+  // Higher levels use a larger table, finding more (and older) matches, and
+  // skip less eagerly through data that doesn't compress. The table is cleared
+  // for every block, so it is kept in proportion to the block
+  unsigned hash_bits = std::min<unsigned>(
+      11 + level, std::max<unsigned>(std::bit_width(size), 10));
+  unsigned skip_shift = 5 + level;
+  table.assign(size_t(1) << hash_bits, 0); // Positions + 1, 0 = unused
+
+  auto hash = [hash_bits](uint32_t value) {
+    return (value * 2654435761u) >> (32 - hash_bits);
+  };
+
+  size_t anchor = 0; // Start of literals not yet written
+
+  if (size > match_limit) {
+    size_t limit = size - match_limit;
+    size_t pos = 0;
+
+    while (pos <= limit) {
+      uint32_t value = read32(data + pos);
+      uint32_t &entry = table[hash(value)];
+      size_t candidate = entry - 1;
+      bool found = entry && pos - candidate <= max_offset &&
+                   read32(data + candidate) == value;
+      entry = pos + 1;
+
+      if (!found) {
+        // Skip faster the longer no match is found
+        pos += 1 + ((pos - anchor) >> skip_shift);
+        continue;
+      }
+
+      // Extend the match backwards into the literals, and forwards
+      while (pos > anchor && candidate > 0 &&
+             data[pos - 1] == data[candidate - 1]) {
+        pos--;
+        candidate--;
+      }
+
+      size_t length = min_match;
+      while (pos + length < size - last_literals &&
+             data[pos + length] == data[candidate + length]) {
+        length++;
+      }
+
+      write_sequence(out, in.substr(anchor, pos - anchor), pos - candidate,
+                     length);
+
+      pos += length;
+      anchor = pos;
+
+      if (pos <= limit) {
+        table[hash(read32(data + pos - 2))] = pos - 2 + 1;
+      }
+    }
+  }
+
+  write_sequence(out, in.substr(anchor), 0, 0);
+}
+
+bool lz4_decompress(std::string_view in, size_t size, std::string &out) {
+  size_t start = out.size();
+  size_t ip = 0;
+  out.reserve(start + size);
+
+  while (ip < in.size()) {
+    uint8_t token = in[ip++];
+
+    size_t literals = token >> 4;
+    if (literals == 15 && !read_length(in, ip, literals)) {
+      return false;
+    }
+    if (literals > in.size() - ip || literals > size - (out.size() - start)) {
+      return false;
+    }
+    out.append(in, ip, literals);
+    ip += literals;
+
+    if (ip == in.size()) {
+      break; // Last sequence has no match
+    }
+
+    if (in.size() - ip < 2) {
+      return false;
+    }
+    size_t offset = static_cast<uint8_t>(in[ip]) |
+                    (static_cast<uint8_t>(in[ip + 1]) << 8);
+    ip += 2;
+
+    size_t length = token & 15;
+    if (length == 15 && !read_length(in, ip, length)) {
+      return false;
+    }
+    length += min_match;
+
+    size_t written = out.size() - start;
+    if (offset == 0 || offset > written || length > size - written) {
+      return false;
+    }
+
+    // The match may overlap what it produces, repeating the last offset
+    // bytes, so it is copied in chunks of what is available
+    for (size_t from = out.size() - offset; length > 0;) {
+      size_t chunk = std::min(length, out.size() - from);
+      out.append(out, from, chunk);
+      length -= chunk;
+    }
+  }
+
+  return out.size() - start == size;
+}
+
+uint32_t xxh32(std::string_view data, uint32_t seed) {
+  constexpr uint32_t prime1 = 2654435761u;
+  constexpr uint32_t prime2 = 2246822519u;
+  constexpr uint32_t prime3 = 3266489917u;
+  constexpr uint32_t prime4 = 668265263u;
+  constexpr uint32_t prime5 = 374761393u;
+
+  auto round = [](uint32_t acc, uint32_t lane) {
+    return std::rotl(acc + lane * prime2, 13) * prime1;
+  };
+
+  const char *p = data.data();
+  const char *end = p + data.size();
+  uint32_t hash;
+
+  if (data.size() >= 16) {
+    uint32_t v1 = seed + prime1 + prime2;
+    uint32_t v2 = seed + prime2;
+    uint32_t v3 = seed;
+    uint32_t v4 = seed - prime1;
+
+    for (; end - p >= 16; p += 16) {
+      v1 = round(v1, read32le(p));
+      v2 = round(v2, read32le(p + 4));
+      v3 = round(v3, read32le(p + 8));
+      v4 = round(v4, read32le(p + 12));
+    }
+
+    hash = std::rotl(v1, 1) + std::rotl(v2, 7) + std::rotl(v3, 12) +
+           std::rotl(v4, 18);
+  } else {
+    hash = seed + prime5;
+  }
+
+  hash += static_cast<uint32_t>(data.size());
+
+  for (; end - p >= 4; p += 4) {
+    hash = std::rotl(hash + read32le(p) * prime3, 17) * prime4;
+  }
+  for (; p < end; p++) {
+    hash = std::rotl(hash + static_cast<uint8_t>(*p) * prime5, 11) * prime1;
+  }
+
+  hash ^= hash >> 15;
+  hash *= prime2;
+  hash ^= hash >> 13;
+  hash *= prime3;
+  hash ^= hash >> 16;
+  return hash;
+}
+
+Compressor::Compressor(unsigned level, size_t block_size)
+    : level(level), block_size(block_size) {
+  assert(block_size > 0);
+}
+
+void Compressor::write_block(std::string_view data, std::string &out) {
+  if (!header_written) {
+    out += magic;
+    header_written = true;
+  }
+
+  compressed.clear();
+  lz4_compress(data, compressed, level, table);
+
+  bool stored = compressed.size() >= data.size();
+  std::string_view payload = stored ? data : std::string_view(compressed);
+  uint32_t checksum = xxh32(data);
+
+  write_varint(out, data.size());
+  out += static_cast<char>(stored ? Codec::stored : Codec::lz4);
+  write_varint(out, payload.size());
+  for (unsigned i = 0; i < 4; i++) {
+    out += static_cast<char>(checksum >> (i * 8));
+  }
+  out += payload;
+}
+
+void Compressor::write(std::string_view data, std::string &out) {
+  // Full blocks are compressed straight from data, without buffering
+  if (pending.empty()) {
+    while (data.size() >= block_size) {
+      write_block(data.substr(0, block_size), out);
+      data.remove_prefix(block_size);
+    }
+    pending = data;
+    return;
+  }
+
+  size_t take = std::min(data.size(), block_size - pending.size());
+  pending.append(data, 0, take);
+  data.remove_prefix(take);
+
+  if (pending.size() == block_size) {
+    write_block(pending, out);
+    pending.clear();
+    write(data, out);
+  }
+}
+
+void Compressor::flush(std::string &out) {
+  if (!pending.empty()) {
+    write_block(pending, out);
+    pending.clear();
+  }
+}
+
+void Compressor::close(std::string &out) {
+  flush(out);
+  if (header_written) {
+    write_varint(out, 0);
+  }
+  header_written = false;
+}
+
+void Compressor::reset() {
+  pending.clear();
+  header_written = false;
+}
+
+Decompressor::Decompressor(std::string_view data) : data(data) {
+  if (data.substr(0, magic.size()) != magic) {
+    valid = false;
+  }
+  pos = magic.size();
+}
+
+bool Decompressor::next(std::string &out) {
+  if (!valid || ended) {
+    return false;
+  }
+
+  uint64_t size;
+  if (!read_varint(data, pos, size)) {
+    valid = false;
+    return false;
+  }
+
+  if (size == 0) {
+    ended = true;
+    return false;
+  }
+
+  uint64_t length;
+  if (pos >= data.size()) {
+    valid = false;
+    return false;
+  }
+  auto codec = static_cast<Codec>(data[pos++]);
+
+  if (!read_varint(data, pos, length) || data.size() - pos < 4 ||
+      length > data.size() - pos - 4) {
+    valid = false;
+    return false;
+  }
+
+  uint32_t checksum = read32le(data.data() + pos);
+  pos += 4;
+  std::string_view payload = data.substr(pos, length);
+  pos += length;
+
+  size_t start = out.size();
+  if (codec == Codec::stored && length == size) {
+    out += payload;
+  } else if (codec != Codec::lz4 ||
+             size > length * 255 || // Max LZ4 expansion
+             !lz4_decompress(payload, size, out)) {
+    out.resize(start);
+    valid = false;
+    return false;
+  }
+
+  if (xxh32(std::string_view(out).substr(start)) != checksum) {
+    out.resize(start);
+    valid = false;
+    return false;
+  }
+
+  return true;
+}
+
+} // namespace BlockCodec
+} // namespace LioLi
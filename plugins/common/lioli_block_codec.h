@@ -0,0 +1,86 @@
+#ifndef lioli_block_codec_d41a7c09
+#define lioli_block_codec_d41a7c09
+
+// Snort includes
+
+// System includes
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Local includes
+
+// Debug includes
+
+namespace LioLi {
+namespace BlockCodec {
+
+// How the data of a block is stored
+enum class Codec : uint8_t {
+  stored = 0, // Uncompressed, used when compression doesn't pay off
+  lz4 = 1,    // LZ4 block format
+};
+
+constexpr unsigned min_level = 1;
+constexpr unsigned max_level = 9;
+
+// LZ4 block format, level (min_level - max_level) trades speed for ratio
+void lz4_compress(std::string_view in, std::string &out, unsigned level,
+                  std::vector<uint32_t> &table);
+// Appends exactly size bytes to out, returns false if in is malformed
+bool lz4_decompress(std::string_view in, size_t size, std::string &out);
+
+uint32_t xxh32(std::string_view data, uint32_t seed = 0);
+
+// Turns a byte stream (e.g. serializer output) into compressed blocks, each
+// framed with its length and a checksum, see lioli_format_notes.txt
+class Compressor {
+  unsigned level;
+  size_t block_size;
+  bool header_written = false;
+  std::string pending;         // Data not yet written as a block
+  std::string compressed;      // Reused between blocks
+  std::vector<uint32_t> table; // Reused between blocks
+
+  void write_block(std::string_view data, std::string &out);
+
+public:
+  Compressor(unsigned level, size_t block_size);
+
+  // Appends data to the stream, every full block is appended to out
+  void write(std::string_view data, std::string &out);
+
+  // Appends all buffered data as a (short) block
+  void flush(std::string &out);
+
+  // Flushes and appends the end of stream marker, the next write starts a
+  // new stream
+  void close(std::string &out);
+
+  // Drops buffered data, the next write starts a new stream
+  void reset();
+};
+
+// Reads a stream written by Compressor
+class Decompressor {
+  std::string_view data;
+  size_t pos = 0;
+  bool valid = true;
+  bool ended = false;
+
+public:
+  Decompressor(std::string_view data);
+
+  // Appends the data of the next block to out. Returns false at the end of
+  // the stream, or if the data is malformed or fails the checksum, in which
+  // case is_valid() returns false
+  bool next(std::string &out);
+
+  bool is_valid() const { return valid; }
+};
+
+} // namespace BlockCodec
+} // namespace LioLi
+
+#endif // lioli_block_codec_d41a7c09
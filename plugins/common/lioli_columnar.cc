@@ -0,0 +1,346 @@
+
+// Snort includes
+
+// System includes
+#include <algorithm>
+#include <charconv>
+#include <numeric>
+
+// Local includes
+#include "lioli_columnar.h"
+
+// Debug includes
+
+namespace LioLi {
+namespace Columnar {
+namespace {
+
+constexpr std::string_view magic("LCOL\0\1", 6);
+
+enum class Encoding : uint8_t {
+  integer = 0,
+  string = 1,
+  dictionary = 2,
+};
+
+// Column flags
+constexpr uint8_t has_counts = 1; // Otherwise every row has exactly one value
+
+// Same encoding as BILL (and GO varints)
+void write_varint(std::string &out, uint64_t number) {
+  do {
+    uint8_t digit = number & 0b0111'1111;
+    number >>= 7;
+    if (number)
+      digit |= 0b1000'0000;
+    out += static_cast<char>(digit);
+  } while (number);
+}
+
+void write_bytes(std::string &out, std::string_view bytes) {
+  write_varint(out, bytes.size());
+  out += bytes;
+}
+
+uint64_t zigzag(int64_t number) {
+  return (static_cast<uint64_t>(number) << 1) ^ (number >> 63);
+}
+
+int64_t unzigzag(uint64_t number) {
+  return static_cast<int64_t>(number >> 1) ^ -static_cast<int64_t>(number & 1);
+}
+
+// Decimal integers without leading zeros, so converting back to text gives
+// the original value
+bool parse_integer(std::string_view text, int64_t &number) {
+  std::string_view digits = text.substr(!text.empty() && text[0] == '-');
+
+  if (digits.empty() ||
+      (digits[0] == '0' && (digits.size() > 1 || digits != text))) {
+    return false;
+  }
+
+  auto [ptr, ec] = std::from_chars(text.data(), text.data() + text.size(),
+                                   number);
+  return ec == std::errc() && ptr == text.data() + text.size();
+}
+
+} // namespace
+
+void Writer::add(const Tree &tree) {
+  tree.visit_values([this](std::string_view path, std::string_view value) {
+    auto itr = index.find(path);
+
+    if (itr == index.end()) {
+      itr = index.emplace(std::string(path), columns.size()).first;
+      columns.push_back({std::string(path), {}, {}});
+    }
+
+    auto &column = columns[itr->second];
+
+    // Rows before the path was first seen have no values
+    column.counts.resize(rows + 1, 0);
+    column.counts[rows]++;
+    column.values.emplace_back(value);
+  });
+
+  rows++;
+}
+
+void Writer::write_column(const Column &column) {
+  write_bytes(block, column.path);
+
+  bool single = std::all_of(column.counts.begin(), column.counts.end(),
+                            [](uint32_t count) { return count == 1; });
+
+  std::vector<int64_t> integers(column.values.size());
+  bool is_integer = true;
+  for (size_t i = 0; i < column.values.size() && is_integer; i++) {
+    is_integer = parse_integer(column.values[i], integers[i]);
+  }
+
+  // Repeated strings are only written once, when it pays off
+  std::unordered_map<std::string_view, uint32_t> entries;
+  if (!is_integer) {
+    for (auto &value : column.values) {
+      entries.emplace(value, entries.size());
+    }
+  }
+  bool use_dictionary =
+      !is_integer && entries.size() * 2 <= column.values.size();
+
+  Encoding encoding = is_integer       ? Encoding::integer
+                      : use_dictionary ? Encoding::dictionary
+                                       : Encoding::string;
+  block += static_cast<char>(encoding);
+  block += static_cast<char>(single ? 0 : has_counts);
+
+  if (!single) {
+    for (auto count : column.counts) {
+      write_varint(block, count);
+    }
+  }
+
+  write_varint(block, column.values.size());
+
+  if (is_integer) {
+    int64_t previous = 0;
+    for (auto number : integers) {
+      // Wrapping is fine, the reader wraps back the same way
+      write_varint(block, zigzag(static_cast<int64_t>(
+                              static_cast<uint64_t>(number) -
+                              static_cast<uint64_t>(previous))));
+      previous = number;
+    }
+  } else if (use_dictionary) {
+    std::vector<std::string_view> ordered(entries.size());
+    for (auto &[value, entry] : entries) {
+      ordered[entry] = value;
+    }
+
+    write_varint(block, ordered.size());
+    for (auto value : ordered) {
+      write_bytes(block, value);
+    }
+    for (auto &value : column.values) {
+      write_varint(block, entries[value]);
+    }
+  } else {
+    for (auto &value : column.values) {
+      write_bytes(block, value);
+    }
+  }
+}
+
+void Writer::write_header(std::string &out) { out += magic; }
+
+void Writer::write_block(std::string &out) {
+  if (rows == 0) {
+    return;
+  }
+
+  block.clear();
+  write_varint(block, rows);
+  write_varint(block, columns.size());
+
+  for (auto &column : columns) {
+    column.counts.resize(rows, 0); // Path missing in the last rows
+    write_column(column);
+  }
+
+  write_varint(out, block.size());
+  out += block;
+
+  columns.clear();
+  index.clear();
+  rows = 0;
+}
+
+void Writer::write_end(std::string &out) { write_varint(out, 0); }
+
+Reader::Reader(std::string_view data) : data(data) {
+  if (data.substr(0, magic.size()) != magic) {
+    valid = false;
+  }
+  pos = magic.size();
+}
+
+bool Reader::read_varint(uint64_t &value) {
+  value = 0;
+
+  for (unsigned shift = 0; shift < 64; shift += 7) {
+    if (pos >= data.size()) {
+      return false;
+    }
+    uint8_t digit = data[pos++];
+    value |= static_cast<uint64_t>(digit & 0b0111'1111) << shift;
+    if (!(digit & 0b1000'0000)) {
+      return true;
+    }
+  }
+
+  return false; // More than 10 bytes
+}
+
+bool Reader::read_bytes(size_t length, std::string_view &bytes) {
+  if (length > data.size() - pos) {
+    return false;
+  }
+  bytes = data.substr(pos, length);
+  pos += length;
+  return true;
+}
+
+bool Reader::read_column(size_t rows, Column &column) {
+  uint64_t length;
+  std::string_view bytes;
+
+  if (!read_varint(length) || !read_bytes(length, column.path) ||
+      !read_bytes(2, bytes)) {
+    return false;
+  }
+
+  auto encoding = static_cast<Encoding>(bytes[0]);
+  uint8_t flags = bytes[1];
+  if (encoding > Encoding::dictionary || (flags & ~has_counts)) {
+    return false;
+  }
+
+  // Rows either have a count or a value, both take at least one byte
+  if (rows > data.size() - pos) {
+    return false;
+  }
+
+  column.counts.assign(rows, 1);
+  if (flags & has_counts) {
+    for (auto &count : column.counts) {
+      uint64_t value;
+      if (!read_varint(value) || value > UINT32_MAX) {
+        return false;
+      }
+      count = value;
+    }
+  }
+
+  uint64_t values;
+  if (!read_varint(values) ||
+      values != std::accumulate(column.counts.begin(), column.counts.end(),
+                                uint64_t(0)) ||
+      values > data.size() - pos) { // Every value takes at least one byte
+    return false;
+  }
+
+  column.integer = encoding == Encoding::integer;
+  column.integers.clear();
+  column.strings.clear();
+
+  if (encoding == Encoding::integer) {
+    column.integers.reserve(values);
+    uint64_t previous = 0;
+    for (uint64_t i = 0; i < values; i++) {
+      uint64_t delta;
+      if (!read_varint(delta)) {
+        return false;
+      }
+      previous += static_cast<uint64_t>(unzigzag(delta));
+      column.integers.push_back(static_cast<int64_t>(previous));
+    }
+  } else if (encoding == Encoding::dictionary) {
+    uint64_t entries;
+    if (!read_varint(entries) || entries > data.size() - pos) {
+      return false;
+    }
+
+    std::vector<std::string_view> dictionary_entries(entries);
+    for (auto &entry : dictionary_entries) {
+      if (!read_varint(length) || !read_bytes(length, entry)) {
+        return false;
+      }
+    }
+
+    column.strings.reserve(values);
+    for (uint64_t i = 0; i < values; i++) {
+      uint64_t entry;
+      if (!read_varint(entry) || entry >= entries) {
+        return false;
+      }
+      column.strings.push_back(dictionary_entries[entry]);
+    }
+  } else {
+    column.strings.reserve(values);
+    for (uint64_t i = 0; i < values; i++) {
+      if (!read_varint(length) || !read_bytes(length, bytes)) {
+        return false;
+      }
+      column.strings.push_back(bytes);
+    }
+  }
+
+  return true;
+}
+
+bool Reader::next(Block &block) {
+  if (!valid || ended) {
+    return false;
+  }
+
+  uint64_t length;
+  if (!read_varint(length)) {
+    valid = false;
+    return false;
+  }
+
+  if (length == 0) {
+    ended = true;
+    return false;
+  }
+
+  size_t block_end = pos + length;
+  uint64_t rows;
+  uint64_t columns;
+
+  if (length > data.size() - pos || !read_varint(rows) ||
+      !read_varint(columns) || columns > length) {
+    valid = false;
+    return false;
+  }
+
+  block.rows = rows;
+  block.columns.resize(columns);
+  for (auto &column : block.columns) {
+    if (!read_column(rows, column) || pos > block_end) {
+      valid = false;
+      return false;
+    }
+  }
+
+  if (pos != block_end) {
+    valid = false;
+    return false;
+  }
+
+  return true;
+}
+
+} // namespace Columnar
+} // namespace LioLi
@@ -0,0 +1,101 @@
+#ifndef lioli_columnar_0b9e4f27
+#define lioli_columnar_0b9e4f27
+
+// Snort includes
+
+// System includes
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+// Local includes
+#include "lioli.h"
+
+// Debug includes
+
+namespace LioLi {
+namespace Columnar {
+
+// Collects trees and writes them as blocks with one column per absolute path,
+// see lioli_format_notes.txt for the format
+class Writer {
+  struct Column {
+    std::string path;
+    std::vector<uint32_t> counts; // Number of values in each row
+    std::vector<std::string> values;
+  };
+
+  // Allows looking up columns by string_view, so no path is copied for
+  // columns already seen in the block
+  struct PathHash {
+    using is_transparent = void;
+    size_t operator()(std::string_view path) const {
+      return std::hash<std::string_view>{}(path);
+    }
+  };
+
+  std::vector<Column> columns;
+  std::unordered_map<std::string, size_t, PathHash, std::equal_to<>> index;
+  size_t rows = 0;
+  std::string block; // Reused between blocks
+
+  void write_column(const Column &column);
+
+public:
+  void add(const Tree &tree);
+
+  // Number of trees collected since the last block
+  size_t get_rows() const { return rows; }
+
+  // Stream header, must be written before the first block
+  static void write_header(std::string &out);
+
+  // Appends the collected trees as one block and starts a new one, nothing is
+  // written if no trees are collected
+  void write_block(std::string &out);
+
+  // End of stream marker
+  static void write_end(std::string &out);
+};
+
+struct Column {
+  std::string_view path;
+  bool integer = false;
+  std::vector<uint32_t> counts;          // Number of values in each row
+  std::vector<int64_t> integers;         // Values of integer columns
+  std::vector<std::string_view> strings; // Values of other columns
+};
+
+struct Block {
+  size_t rows = 0;
+  std::vector<Column> columns;
+};
+
+// Reads a stream written by Writer. The views in the blocks point into the
+// data given to the reader, so it must outlive them
+class Reader {
+  std::string_view data;
+  size_t pos = 0;
+  bool valid = true;
+  bool ended = false;
+
+  bool read_varint(uint64_t &value);
+  bool read_bytes(size_t length, std::string_view &bytes);
+  bool read_column(size_t rows, Column &column);
+
+public:
+  Reader(std::string_view data);
+
+  // Returns false at the end of the stream, or if the data is malformed, in
+  // which case is_valid() returns false
+  bool next(Block &block);
+
+  bool is_valid() const { return valid; }
+};
+
+} // namespace Columnar
+} // namespace LioLi
+
+#endif // lioli_columnar_0b9e4f27
@@ -0,0 +1,152 @@
+
+// Snort includes
+
+// System includes
+#include <bit>
+
+#if defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+// Local includes
+#include "lioli_escape.h"
+
+// Debug includes
+
+namespace LioLi {
+namespace Escape {
+namespace {
+
+template <Set set> bool is_special(unsigned char c) {
+  if constexpr (set == Set::lorth) {
+    return c == '"' || c == '\n' || c == '\t' || c == '\r';
+  } else {
+    return c == '"' || c == '\\' || c < 0x20 || c >= 0x80;
+  }
+}
+
+// Scans from pos to size, used by all implementations for the tail that
+// doesn't fill a vector
+template <Set set>
+size_t scan_scalar(const char *data, size_t pos, size_t size) {
+  for (; pos < size; pos++) {
+    if (is_special<set>(data[pos])) {
+      return pos;
+    }
+  }
+  return size;
+}
+
+template <Set set> size_t find_scalar(const char *data, size_t size) {
+  return scan_scalar<set>(data, 0, size);
+}
+
+#if defined(__SSE2__)
+// Always inlined, so the copy used for the tail of find_avx2() is VEX encoded
+// as well, mixing in legacy SSE encoding after AVX costs a state transition
+template <Set set>
+[[gnu::always_inline]] inline size_t find_sse2(const char *data,
+                                               size_t size) {
+  size_t pos = 0;
+
+  for (; pos + 16 <= size; pos += 16) {
+    __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + pos));
+    __m128i hit;
+
+    if constexpr (set == Set::lorth) {
+      hit = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('"')),
+                                      _mm_cmpeq_epi8(v, _mm_set1_epi8('\n'))),
+                         _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('\t')),
+                                      _mm_cmpeq_epi8(v, _mm_set1_epi8('\r'))));
+    } else {
+      // The compare is signed, so bytes >= 0x80 are negative and less than
+      // 0x20 as well
+      hit = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('"')),
+                                      _mm_cmpeq_epi8(v, _mm_set1_epi8('\\'))),
+                         _mm_cmplt_epi8(v, _mm_set1_epi8(0x20)));
+    }
+
+    unsigned mask = _mm_movemask_epi8(hit);
+    if (mask) {
+      return pos + std::countr_zero(mask);
+    }
+  }
+
+  return scan_scalar<set>(data, pos, size);
+}
+#endif
+
+#if defined(__x86_64__)
+// Compiled for AVX2 regardless of build flags, only called when the CPU has
+// been found to support it
+template <Set set>
+__attribute__((target("avx2"))) size_t find_avx2(const char *data,
+                                                 size_t size) {
+  size_t pos = 0;
+
+  for (; pos + 32 <= size; pos += 32) {
+    __m256i v =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i *>(data + pos));
+    __m256i hit;
+
+    if constexpr (set == Set::lorth) {
+      hit = _mm256_or_si256(
+          _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('"')),
+                          _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\n'))),
+          _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('\t')),
+                          _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\r'))));
+    } else {
+      // Signed compare, see find_sse2()
+      hit = _mm256_or_si256(
+          _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('"')),
+                          _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\\'))),
+          _mm256_cmpgt_epi8(_mm256_set1_epi8(0x20), v));
+    }
+
+    unsigned mask = _mm256_movemask_epi8(hit);
+    if (mask) {
+      return pos + std::countr_zero(mask);
+    }
+  }
+
+  return pos + find_sse2<set>(data + pos, size - pos);
+}
+#endif
+
+} // namespace
+
+const std::vector<Implementation> &implementations() {
+  // Picked once, on first use
+  static const std::vector<Implementation> available = [] {
+    std::vector<Implementation> available;
+#if defined(__x86_64__)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+      available.push_back(
+          {"avx2", find_avx2<Set::lorth>, find_avx2<Set::json>});
+    }
+#endif
+#if defined(__SSE2__)
+    available.push_back({"sse2", find_sse2<Set::lorth>, find_sse2<Set::json>});
+#endif
+    available.push_back(
+        {"scalar", find_scalar<Set::lorth>, find_scalar<Set::json>});
+    return available;
+  }();
+
+  return available;
+}
+
+size_t find(std::string_view data, Set set) {
+  static const Implementation &implementation = implementations().front();
+
+  if (set == Set::lorth) {
+    return implementation.lorth(data.data(), data.size());
+  }
+  return implementation.json(data.data(), data.size());
+}
+
+const char *implementation() { return implementations().front().name; }
+
+} // namespace Escape
+} // namespace LioLi
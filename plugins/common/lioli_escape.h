@@ -0,0 +1,46 @@
+#ifndef lioli_escape_5be1a0c3
+#define lioli_escape_5be1a0c3
+
+// Snort includes
+
+// System includes
+#include <cstddef>
+#include <string_view>
+#include <vector>
+
+// Local includes
+
+// Debug includes
+
+namespace LioLi {
+namespace Escape {
+
+// The bytes a text serializer can't copy as is
+enum class Set {
+  lorth, // '"', '\n', '\t' and '\r'
+  json,  // '"', '\\', control chars (< 0x20) and non ASCII bytes (>= 0x80)
+};
+
+// Returns the offset of the first byte in data belonging to set, or
+// data.size() if there is none. Uses AVX2 or SSE2 when the CPU supports it,
+// so the clean spans in between can be copied in bulk by the caller
+size_t find(std::string_view data, Set set);
+
+// Name of the implementation picked for this CPU ("avx2", "sse2" or "scalar")
+const char *implementation();
+
+// An implementation of find() for each set
+struct Implementation {
+  const char *name;
+  size_t (*lorth)(const char *data, size_t size);
+  size_t (*json)(const char *data, size_t size);
+};
+
+// All implementations this CPU can run, the one find() uses first. For tests
+// and benchmarks comparing them
+const std::vector<Implementation> &implementations();
+
+} // namespace Escape
+} // namespace LioLi
+
+#endif // lioli_escape_5be1a0c3
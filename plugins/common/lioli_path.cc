@@ -2,6 +2,7 @@
 // Snort includes
 
 // System includes
+#include <algorithm>
 #include <cassert>
 #include <regex>
 
@@ -14,7 +15,9 @@
 
 namespace LioLi {
 
-Path::Path(const Path &src) : relative(src.relative), absolute(src.absolute) {
+Path::Path(const Path &src)
+    : relative(src.relative), absolute(src.absolute),
+      snapshots(src.snapshots) {
   me = (src.is_absolute() ? absolute : relative).find(src.me->first);
 
   assert(me != absolute.end() && me != relative.end());
@@ -25,6 +28,7 @@ Path::Path(Path &&src) { *this = std::move(src); }
 Path &Path::operator=(const Path &src) {
   relative = src.relative;
   absolute = src.absolute;
+  snapshots = src.snapshots;
 
   me = (src.is_absolute() ? absolute : relative).find(src.me->first);
 
@@ -36,6 +40,7 @@ Path &Path::operator=(Path &&src) {
 
   relative = std::move(src.relative);
   absolute = std::move(src.absolute);
+  snapshots = std::move(src.snapshots);
 
   me = (src.is_absolute() ? absolute : relative).find(src.me->first);
 
@@ -97,21 +102,25 @@ bool Path::is_relative() const { return is_relative(me->first); }
 
 Path &Path::operator<<(const std::string &text) {
   me->second << text;
+  changed(me->first);
   return *this;
 }
 
 Path &Path::operator<<(const int number) {
   me->second << number;
+  changed(me->first);
   return *this;
 }
 
 Path &Path::operator<<(const Tree &tree) {
   me->second << tree;
+  changed(me->first);
   return *this;
 }
 
 Path &Path::operator<<(Tree &&tree) {
   me->second << std::move(tree);
+  changed(me->first);
   return *this;
 }
 
@@ -133,12 +142,16 @@ Path &Path::operator<<(Path &&path) {
     if (!r.second) {
       r.first->second.merge(iter.second);
     }
+    changed(r.first->first);
   }
 
   path.relative.clear();
 
   // Absolute paths are added to our absolute list, if there are conflicts, the
   // result trees should be merged
+  for (auto &iter : path.absolute) {
+    changed(iter.first);
+  }
   absolute.merge(path.absolute);
 
   if (!path.absolute.empty()) {
@@ -156,53 +169,216 @@ Path &Path::operator<<(Path &&path) {
   return *this;
 }
 
+Path &Path::add_text(const std::string &path, std::string_view text) {
+  assert(is_absolute(path));
+
+  absolute[path].add_text(text);
+  changed(path);
+  return *this;
+}
+
+Path &Path::erase_text(const std::string &path, size_t pos, size_t length) {
+  auto itr = absolute.find(path);
+  assert(itr != absolute.end());
+
+  auto text = itr->second.get_value(itr->second.get_root_name());
+  assert(text && pos + length <= text->size());
+
+  Tree rest;
+  rest.add_text(text->substr(0, pos)).add_text(text->substr(pos + length));
+  changed(path);
+
+  if (rest.size() == 0 && itr != me) {
+    absolute.erase(itr);
+  } else {
+    itr->second = std::move(rest);
+  }
+  return *this;
+}
+
+std::string_view Path::top_level(std::string_view path) {
+  // Empty for the root, it isn't part of any top level node
+  return path.substr(0, path.size() > 1 ? path.find('.', 2) : 0);
+}
+
+bool Path::is_at_or_below(std::string_view path, std::string_view top) {
+  return path.starts_with(top) &&
+         (path.size() == top.size() || path[top.size()] == '.');
+}
+
+void Path::changed(const std::string &path) {
+  if (is_absolute(path)) {
+    auto top = top_level(path);
+    if (!top.empty()) {
+      snapshots.erase(std::string(top));
+    }
+  }
+}
+
+const Path::Map::value_type &Path::get_snapshot(std::string_view top) const {
+  std::string key(top);
+  auto itr = snapshots.find(key);
+
+  if (itr == snapshots.end()) {
+    TreeBuilder builder;
+    builder.entries = TreeBuilder::paths(*this, top);
+
+    Tree snapshot = builder.build(Tree(key.substr(key.rfind('.') + 1)), top);
+    itr = snapshots.emplace(std::move(key), std::move(snapshot)).first;
+    itr->second.memoize();
+  }
+  return *itr;
+}
+
+size_t Path::size() const {
+  size_t size = 0;
+
+  for (auto &[name, tree] : relative) {
+    size += tree.size();
+  }
+  for (auto &[name, tree] : absolute) {
+    size += tree.size();
+  }
+  return size;
+}
+
 Tree Path::to_tree() const {
   assert(relative.size() == 0); // We can't generate a relative tree
 
-  class Node {
-    Tree me = {"$"};
-    std::map<std::string, Node> map;
-
-  public:
-    void add(std::string key, Tree &value) {
-      size_t pos = std::string("$.").size(); // We skip the initial "$.", string
-                                             // funcs are constexpr (C++20)
-      Node *node = this;
-      while (pos < key.size()) {
-        auto new_pos = key.find('.', pos);
-        std::string sub_key;
-
-        if (new_pos == std::string::npos) {
-          sub_key = key.substr(pos);
-          new_pos = key.size();
-        } else {
-          sub_key = key.substr(pos, new_pos - pos);
-        }
-
-        pos = new_pos + 1;
-        node = &node->map[sub_key];
-        node->me.set_root_name(sub_key);
-      }
+  return TreeBuilder().add(*this).build(Tree("$"));
+}
+
+TreeBuilder &TreeBuilder::add(std::string_view path, const Tree &tree) {
+  assert(Path::is_absolute(std::string(path)));
+
+  entries.push_back({path, &tree, Entry::Kind::child});
+  return *this;
+}
+
+TreeBuilder &TreeBuilder::add(const Path &path) {
+  assert(path.relative.size() == 0); // We can't generate a relative tree
 
-      node->me.merge(value);
+  // The paths of a top level node follow each other in the map, they are
+  // added as its snapshot
+  for (auto itr = path.absolute.begin(); itr != path.absolute.end();) {
+    auto top = Path::top_level(itr->first);
+
+    if (top.empty()) {
+      entries.push_back({itr->first, &itr->second, Entry::Kind::merge});
+      ++itr;
+      continue;
     }
 
-    Tree gen_tree() const {
-      Tree tree = me;
+    auto &[name, snapshot] = path.get_snapshot(top);
+    entries.push_back({name, &snapshot, Entry::Kind::node, &path});
 
-      for (auto node : map) {
-        tree << node.second.gen_tree();
-      }
+    while (itr != path.absolute.end() &&
+           Path::is_at_or_below(itr->first, name)) {
+      ++itr;
+    }
+  }
+  return *this;
+}
+
+std::vector<TreeBuilder::Entry> TreeBuilder::paths(const Path &path,
+                                                   std::string_view top) {
+  std::vector<Entry> paths;
+
+  for (auto itr = path.absolute.lower_bound(std::string(top));
+       itr != path.absolute.end() && Path::is_at_or_below(itr->first, top);
+       ++itr) {
+    paths.push_back({itr->first, &itr->second, Entry::Kind::merge});
+  }
+  return paths;
+}
+
+Tree TreeBuilder::build(Tree &&root, std::string_view root_path) {
+  // A snapshot has the nodes below it in path order, so it can only be used
+  // if nothing else is added at or below it, except (added before it) at its
+  // own path. Otherwise its paths are added one by one, in its place
+  for (size_t i = 0; i < entries.size(); i++) {
+    if (entries[i].kind != Entry::Kind::node) {
+      continue;
+    }
+
+    bool shared = false;
+    for (size_t j = 0; j < entries.size() && !shared; j++) {
+      shared = j != i &&
+               Path::is_at_or_below(entries[j].path, entries[i].path) &&
+               (j > i || entries[j].kind == Entry::Kind::node ||
+                entries[j].path != entries[i].path);
+    }
+    if (shared) {
+      auto expanded = paths(*entries[i].from, entries[i].path);
+      entries.erase(entries.begin() + i);
+      entries.insert(entries.begin() + i, expanded.begin(), expanded.end());
+    }
+  }
 
-      return tree;
+  // Node names never contain '.' and their characters sort after it, so
+  // sorting the paths as text puts parents before their children, and
+  // siblings in name order
+  std::stable_sort(
+      entries.begin(), entries.end(),
+      [](const Entry &a, const Entry &b) { return a.path < b.path; });
+
+  // The nodes on the path of the last entry, root first
+  struct Open {
+    std::string_view path;
+    Tree tree;
+  };
+  std::vector<Open> open;
+  open.push_back({root_path, std::move(root)});
+
+  auto close = [&open]() {
+    Tree tree = std::move(open.back().tree);
+    open.pop_back();
+    open.back().tree << std::move(tree);
+  };
+
+  for (auto &entry : entries) {
+    while (open.size() > 1 &&
+           !Path::is_at_or_below(entry.path, open.back().path)) {
+      close();
     }
-  } tree;
 
-  for (auto itr : absolute) {
-    tree.add(itr.first, itr.second);
+    // A snapshot is the node itself, so only its parents are opened
+    size_t end = entry.path.size();
+    if (entry.kind == Entry::Kind::node && open.back().path != entry.path) {
+      end = entry.path.rfind('.');
+    }
+
+    for (size_t pos = open.back().path.size(); pos < end;) {
+      size_t next = std::min(entry.path.find('.', pos + 1), entry.path.size());
+      open.push_back({entry.path.substr(0, next),
+                      Tree(std::string(entry.path.substr(pos + 1,
+                                                         next - pos - 1)))});
+      pos = next;
+    }
+
+    switch (entry.kind) {
+    case Entry::Kind::child:
+      open.back().tree << *entry.tree;
+      break;
+    case Entry::Kind::merge:
+      open.back().tree.merge(*entry.tree);
+      break;
+    case Entry::Kind::node:
+      if (open.back().path == entry.path) {
+        open.back().tree.merge(*entry.tree);
+      } else {
+        open.push_back({entry.path, *entry.tree});
+      }
+      break;
+    }
+  }
+
+  while (open.size() > 1) {
+    close();
   }
+  entries.clear();
 
-  return tree.gen_tree();
+  return std::move(open.back().tree);
 }
 
 } // namespace LioLi
@@ -7,6 +7,8 @@
 // System includes
 #include <map>
 #include <string>
+#include <string_view>
+#include <vector>
 
 // Local includes
 #include "lioli.h"
@@ -17,12 +19,25 @@
 
 namespace LioLi {
 
+class TreeBuilder;
+
 class Path {
   using Map = std::map<std::string, Tree>;
   Map relative;
   Map absolute;
   Map::iterator me;
 
+  // The top level nodes of the absolute paths (e.g. "$.a" with everything at
+  // and below it) as built by to_tree(), memoized until a path below them
+  // changes. A path that grows over a flow is then only rebuilt where it
+  // changed, not for every tree built from it
+  mutable Map snapshots;
+
+  static std::string_view top_level(std::string_view path);
+  static bool is_at_or_below(std::string_view path, std::string_view top);
+  void changed(const std::string &path);
+  const Map::value_type &get_snapshot(std::string_view top) const;
+
 public:
   Path(const Path &);
   Path(Path &&);
@@ -61,12 +76,62 @@ public:
   Path &operator<<(const Path &path);
   Path &operator<<(Path &&path);
 
+  // Appends text to the tree at the absolute path, as
+  // *this << (Path(path) << text) does, without the temporary path
+  Path &add_text(const std::string &path, std::string_view text);
+
+  // Removes length bytes at pos from the tree at the absolute path, which
+  // must only hold text (as added by add_text()). A tree left empty is
+  // removed, as if nothing had been added at the path
+  Path &erase_text(const std::string &path, size_t pos, size_t length);
+
   uint32_t hash() const {
     return (me->first.length() + me->second.hash()) ^
            (relative.size() + (absolute.size() << 8));
   } // Very fast and simple hash function
 
+  // Bytes of text held by the trees of the path
+  size_t size() const;
+
   Tree to_tree() const;
+
+  friend class TreeBuilder;
+};
+
+// Builds the tree Path::to_tree() would give for a set of absolute paths,
+// without the intermediate paths and maps, and copying each tree only once.
+// Meant for trees of a known shape, e.g. an alert: the root is built directly
+// and the parts at known paths (and any Path) are added to the builder
+class TreeBuilder {
+  struct Entry {
+    std::string_view path;
+    const Tree *tree;
+    enum class Kind {
+      child, // Added as a child of the node
+      merge, // Merged into the node
+      node,  // Is the node (a snapshot of from), merged if already there
+    } kind;
+    const Path *from = nullptr;
+  };
+  std::vector<Entry> entries;
+
+  // The entries of the paths of path at or below top
+  static std::vector<Entry> paths(const Path &path, std::string_view top);
+  Tree build(Tree &&root, std::string_view root_path);
+
+public:
+  // Adds tree as a child of the node at path, as Path(path) << tree does.
+  // The tree (and path) must stay valid until build()
+  TreeBuilder &add(std::string_view path, const Tree &tree);
+
+  // Adds all (absolute) paths of path, as Path("$") << path does
+  TreeBuilder &add(const Path &path);
+
+  // Nodes are added to root in path order, trees at the same path are merged
+  // in the order they were added
+  Tree build(Tree &&root) { return build(std::move(root), "$"); }
+
+  friend class Path;
 };
 
 } // namespace LioLi
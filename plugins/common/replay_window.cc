@@ -0,0 +1,61 @@
+
+// Snort includes
+
+// System includes
+
+// Local includes
+#include "replay_window.h"
+
+// Debug includes
+
+namespace LioLi {
+
+ReplayWindow::ReplayWindow(size_t max_records) : max_records(max_records) {}
+
+void ReplayWindow::set_max_records(size_t max) {
+  max_records = max;
+  while (records.size() > max_records) {
+    records.pop_front();
+  }
+}
+
+void ReplayWindow::add(uint64_t sequence, std::string data) {
+  records.push_back({sequence, std::move(data)});
+  while (records.size() > max_records) {
+    records.pop_front();
+  }
+}
+
+void ReplayWindow::ack(uint64_t sequence) {
+  while (!records.empty() && records.front().sequence <= sequence) {
+    records.pop_front();
+  }
+}
+
+uint64_t ReplayWindow::resume(uint64_t after) {
+  resume_pending = true;
+  resume_after = after;
+
+  for (auto &record : records) {
+    if (record.sequence > after) {
+      return record.sequence;
+    }
+  }
+  return next;
+}
+
+std::string ReplayWindow::take_replay() {
+  std::string output;
+
+  for (auto &record : records) {
+    if (record.sequence > resume_after) {
+      output += record.data;
+    }
+  }
+
+  resume_pending = false;
+  holding = false;
+  return output;
+}
+
+} // namespace LioLi
@@ -0,0 +1,73 @@
+#ifndef replay_window_5b0e93d2
+#define replay_window_5b0e93d2
+
+// Snort includes
+
+// System includes
+#include <cstdint>
+#include <deque>
+#include <string>
+
+// Local includes
+
+// Debug includes
+
+namespace LioLi {
+
+// Resumable delivery of a sequenced stream (see lioli_format_notes.txt).
+// Records are kept after being written until they are acked or pushed out of
+// the window, a consumer that reconnects resumes after the last record it
+// has. Not thread safe, the owner serializes access
+class ReplayWindow {
+  struct Record {
+    uint64_t sequence;
+    std::string data;
+  };
+  std::deque<Record> records;
+  size_t max_records;
+  uint64_t next = 1;
+
+  bool resume_pending = false;
+  uint64_t resume_after = 0; // Last sequence number the consumer has
+  bool holding = false;      // New records wait for the consumer's resume
+
+public:
+  ReplayWindow(size_t max_records = 0);
+
+  // Drops the oldest records if there are more than max_records
+  void set_max_records(size_t max_records);
+
+  // Returns the sequence number of the next record, which must be added
+  // before the next call
+  uint64_t next_sequence() { return next++; }
+
+  // Keeps a written (or about to be written) record
+  void add(uint64_t sequence, std::string data);
+
+  // Records up to and including sequence are released
+  void ack(uint64_t sequence);
+
+  // The consumer has everything up to and including after, returns the
+  // first sequence number that will be sent, a gap means records were lost
+  uint64_t resume(uint64_t after);
+
+  // A new stream is started, new records are held until the consumer
+  // resumes, so the replay is written before them
+  void hold() { holding = true; }
+
+  // True if new records must not be written yet
+  bool is_holding() const { return holding; }
+
+  // True if a resume is waiting for take_replay()
+  bool has_replay() const { return resume_pending; }
+
+  // Returns the records to replay (all kept after the resumed sequence
+  // number), new records can be written after these
+  std::string take_replay();
+
+  size_t size() const { return records.size(); }
+};
+
+} // namespace LioLi
+
+#endif // replay_window_5b0e93d2
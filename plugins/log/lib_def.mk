@@ -10,23 +10,38 @@ PUBLIC_INC := ./public_include
 
 # List source (.cc) files that should be included in the build
 CC_FILES := \
+	lioli_tree_logger.cc \
 	log_framework.cc \
+	logger_databus.cc \
 	logger_file.cc \
 	logger_null.cc \
 	logger_pipe.cc \
+	logger_ratelimit.cc \
+	logger_stats.cc \
 	logger_stdout.cc \
 	serializer_bill.cc \
+	serializer_cbor.cc \
+	serializer_columnar.cc \
+	serializer_json.cc \
 	serializer_lorth.cc \
 	serializer_txt.cc \
 
 
 H_FILES = \
+	lioli_tree_logger.h \
+	logger_databus.h \
 	logger_file.h \
 	logger_null.h \
 	logger_pipe.h \
+	logger_ratelimit.h \
 	logger_stdout.h \
+	public_include/lioli_tree_event.h \
 	public_include/log_framework.h \
+	public_include/logger_stats.h \
 	serializer_bill.h \
+	serializer_cbor.h \
+	serializer_columnar.h \
+	serializer_json.h \
 	serializer_lorth.h \
 	serializer_txt.h \
 
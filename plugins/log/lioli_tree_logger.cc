@@ -0,0 +1,174 @@
+// Snort includes
+#include <framework/counts.h>
+#include <framework/data_bus.h>
+#include <framework/decode_data.h>
+#include <framework/inspector.h>
+#include <framework/module.h>
+#include <log/messages.h>
+
+// System includes
+#include <cassert>
+#include <string>
+
+// Local includes
+#include "lioli.h"
+#include "lioli_tree_event.h"
+#include "lioli_tree_logger.h"
+#include "log_framework.h"
+
+// Debug includes
+
+namespace lioli_tree_logger {
+namespace {
+
+static const char *s_name = "lioli_tree_logger";
+static const char *s_help =
+    "Subscribes to the LioLi trees published by logger_databus and sends "
+    "them to a logger";
+
+static const snort::Parameter module_params[] = {
+    {"logger", snort::Parameter::PT_STRING, nullptr, nullptr,
+     "Set logger received trees should be sent to"},
+    {nullptr, snort::Parameter::PT_MAX, nullptr, nullptr, nullptr}};
+
+// This must match the s_pegs[] array
+struct PegCounts {
+  PegCount received = 0;
+};
+
+static THREAD_LOCAL PegCounts s_peg_counts;
+
+const PegInfo s_pegs[] = {
+    {CountType::SUM, "received", "Trees received from the DataBus"},
+    {CountType::END, nullptr, nullptr}};
+
+// Compile time sanity check of number of entries in s_pegs and s_peg_counts
+static_assert(
+    (sizeof(s_pegs) / sizeof(PegInfo)) - 1 ==
+        sizeof(PegCounts) / sizeof(PegCount),
+    "Entries in s_pegs doesn't match number of entries in s_peg_counts");
+
+class Module : public snort::Module {
+  Module() : snort::Module(s_name, s_help, module_params) {}
+
+  std::string logger_name;
+
+  bool begin(const char *, int, snort::SnortConfig *) override {
+    logger_name.clear();
+    return true;
+  }
+
+  bool set(const char *, snort::Value &val, snort::SnortConfig *) override {
+    if (val.is("logger") && val.get_as_string().size() > 0) {
+      logger_name = val.get_string();
+      return true;
+    }
+
+    // fail if we didn't get something valid
+    return false;
+  }
+
+  bool end(const char *, int, snort::SnortConfig *) override {
+    if (logger_name.empty()) {
+      snort::ErrorMessage("ERROR: no logger specified for %s\n", s_name);
+      return false;
+    }
+    if (logger_name == "logger_databus") {
+      // Every received tree would be published again
+      snort::ErrorMessage("ERROR: logger_databus can't be used in %s\n",
+                          s_name);
+      return false;
+    }
+    return true;
+  }
+
+  const PegInfo *get_pegs() const override { return s_pegs; }
+
+  PegCount *get_counts() const override {
+    return reinterpret_cast<PegCount *>(&s_peg_counts);
+  }
+
+  Usage get_usage() const override { return GLOBAL; }
+
+public:
+  std::string &get_logger_name() { return logger_name; }
+
+  static snort::Module *ctor() { return new Module(); }
+  static void dtor(snort::Module *p) { delete p; }
+};
+
+class TreeEventHandler : public snort::DataHandler {
+  std::shared_ptr<LioLi::Logger> logger;
+
+public:
+  TreeEventHandler(std::shared_ptr<LioLi::Logger> logger)
+      : DataHandler(s_name), logger(logger) {}
+
+  void handle(snort::DataEvent &event, snort::Flow *) override {
+    s_peg_counts.received++;
+
+    // The published tree is only valid during the publish, so the logger
+    // (which may queue it) gets a copy
+    LioLi::Tree tree = static_cast<LioLi::TreeEvent &>(event).get_tree();
+    *logger << std::move(tree);
+  }
+};
+
+class Inspector : public snort::Inspector {
+  std::string logger_name;
+
+  Inspector(Module *module) {
+    assert(module);
+
+    logger_name = module->get_logger_name();
+  }
+
+  void eval(snort::Packet *) override{};
+
+  bool configure(snort::SnortConfig *sc) override {
+    snort::DataBus::subscribe_global(
+        LioLi::tree_pub_key, LioLi::TreeEventIds::TREE,
+        new TreeEventHandler(
+            LioLi::LogDB::get<LioLi::Logger>(logger_name.c_str())),
+        *sc);
+    return true;
+  }
+
+public:
+  static snort::Inspector *ctor(snort::Module *module) {
+    return new Inspector(dynamic_cast<Module *>(module));
+  }
+  static void dtor(snort::Inspector *p) { delete p; }
+};
+
+} // namespace
+
+const snort::InspectApi inspect_api = {
+    {
+        PT_INSPECTOR,
+        sizeof(snort::InspectApi),
+        INSAPI_VERSION,
+        0,
+        API_RESERVED,
+        API_OPTIONS,
+        s_name,
+        s_help,
+        Module::ctor,
+        Module::dtor,
+    },
+
+    snort::IT_PASSIVE,
+    PROTO_BIT__NONE,
+    nullptr, // buffers
+    nullptr, // service
+    nullptr, // pinit
+    nullptr, // pterm
+    nullptr, // tinit
+    nullptr, // tterm
+    Inspector::ctor,
+    Inspector::dtor,
+    nullptr, // ssn
+    nullptr  // reset
+};
+
+} // namespace lioli_tree_logger
@@ -0,0 +1,18 @@
+#ifndef lioli_tree_logger_e4c17a58
+#define lioli_tree_logger_e4c17a58
+
+// Snort includes
+#include <framework/base_api.h>
+#include <framework/inspector.h>
+
+// System includes
+
+// Local includes
+
+namespace lioli_tree_logger {
+
+extern const snort::InspectApi inspect_api;
+
+} // namespace lioli_tree_logger
+
+#endif // #ifndef lioli_tree_logger_e4c17a58
@@ -2,6 +2,8 @@
 // Snort includes
 
 // System includes
+#include <list>
+#include <unordered_map>
 
 // Local includes
 #include "log_framework.h"
@@ -41,6 +43,97 @@ std::shared_ptr<Serializer> &Serializer::get_null_obj() {
   return null_serializer;
 }
 
+namespace {
+
+class TemplatedContext : public Serializer::Context {
+  std::shared_ptr<Serializer::Context> context;
+  size_t max_templates;
+
+  // Templates by their text, with the most recently used first in lru
+  struct Entry {
+    uint32_t id;
+    std::list<std::string>::iterator lru;
+  };
+  std::unordered_map<std::string, Entry> templates;
+  std::list<std::string> lru;
+
+  // Returns the id of the template, out gets its definition if the template
+  // hasn't been seen (or has been forgotten). The key is kept with the mark,
+  // so a known template isn't serialized again
+  uint32_t lookup(const std::string &key, Tree &&head, std::string &out) {
+    auto itr = templates.find(key);
+
+    if (itr != templates.end()) {
+      lru.splice(lru.begin(), lru, itr->second.lru);
+      return itr->second.id;
+    }
+
+    uint32_t id = templates.size() + 1;
+    if (templates.size() >= max_templates) {
+      // The consumer replaces the template when it sees the new definition
+      auto oldest = templates.find(lru.back());
+      id = oldest->second.id;
+      templates.erase(oldest);
+      lru.pop_back();
+    }
+
+    lru.push_front(key);
+    templates.emplace(key, Entry{id, lru.begin()});
+
+    Tree definition("#template");
+    definition << (Tree("id") << std::to_string(id));
+    head.set_root_name("#template");
+    definition.merge(std::move(head));
+    context->serialize_into(std::move(definition), out);
+
+    return id;
+  }
+
+public:
+  TemplatedContext(std::shared_ptr<Serializer::Context> context,
+                   size_t max_templates)
+      : context(context), max_templates(max_templates) {
+    assert(max_templates > 0);
+  }
+
+  std::string serialize(const Tree &&tree) override {
+    std::string out;
+    serialize_into(std::move(tree), out);
+    return out;
+  }
+
+  void serialize_into(const Tree &&tree, std::string &out) override {
+    Tree head;
+    Tree tail;
+
+    if (!tree.split_template(head, tail)) {
+      context->serialize_into(std::move(tree), out);
+      return;
+    }
+
+    // The definition (if any) must be written before the record using it
+    uint32_t id = lookup(tree.get_template_key(), std::move(head), out);
+
+    Tree record(tree.get_root_name());
+    record << (Tree("#template") << std::to_string(id));
+    record.merge(std::move(tail));
+    context->serialize_into(std::move(record), out);
+  }
+
+  std::string open() override { return context->open(); }
+
+  std::string close() override { return context->close(); }
+
+  bool is_closed() override { return context->is_closed(); }
+};
+
+} // namespace
+
+std::shared_ptr<Serializer::Context>
+Serializer::create_templated_context(size_t max_templates) {
+  return std::make_shared<TemplatedContext>(create_context(), max_templates);
+}
+
 std::shared_ptr<Logger> &Logger::get_null_obj() {
   class NullLogger : public Logger {
     void operator<<(const Tree &&) override {}
@@ -0,0 +1,155 @@
+
+// Snort includes
+#include <framework/counts.h>
+#include <framework/data_bus.h>
+#include <framework/decode_data.h>
+#include <framework/inspector.h>
+#include <framework/module.h>
+
+// System includes
+#include <atomic>
+
+// Local includes
+#include "lioli.h"
+#include "lioli_tree_event.h"
+#include "log_framework.h"
+#include "logger_databus.h"
+
+// Debug includes
+
+namespace LioLi {
+
+const snort::PubKey tree_pub_key{"lioli_tree", TreeEventIds::num_ids};
+
+} // namespace LioLi
+
+namespace logger_databus {
+namespace {
+
+static const char *s_name = "logger_databus";
+static const char *s_help =
+    "Publishes LioLi trees on the DataBus for in-process consumers";
+
+static const snort::Parameter module_params[] = {
+    {nullptr, snort::Parameter::PT_MAX, nullptr, nullptr, nullptr}};
+
+// This must match the s_pegs[] array
+struct PegCounts {
+  PegCount published = 0;
+  PegCount not_configured = 0;
+};
+
+static THREAD_LOCAL PegCounts s_peg_counts;
+
+const PegInfo s_pegs[] = {
+    {CountType::SUM, "published", "Trees published on the DataBus"},
+    {CountType::SUM, "not_configured",
+     "Trees dropped as the inspector wasn't configured"},
+    {CountType::END, nullptr, nullptr}};
+
+// Compile time sanity check of number of entries in s_pegs and s_peg_counts
+static_assert(
+    (sizeof(s_pegs) / sizeof(PegInfo)) - 1 ==
+        sizeof(PegCounts) / sizeof(PegCount),
+    "Entries in s_pegs doesn't match number of entries in s_peg_counts");
+
+// MAIN object of this file
+class Logger : public LioLi::Logger {
+  std::atomic<bool> configured = false;
+  unsigned pub_id = 0;
+
+public:
+  Logger() : LioLi::Logger(s_name) {}
+
+  ~Logger() {}
+
+  // Must be called before any packet thread logs to us
+  void set_pub_id(unsigned id) {
+    pub_id = id;
+    configured = true;
+  }
+
+  void operator<<(const LioLi::Tree &&tree) override {
+    if (!configured) {
+      s_peg_counts.not_configured++;
+      return;
+    }
+
+    // Subscribers get the tree by reference, nothing is copied
+    LioLi::TreeEvent event(tree);
+    snort::DataBus::publish(pub_id, LioLi::TreeEventIds::TREE, event);
+
+    s_peg_counts.published++;
+  }
+};
+
+class Module : public snort::Module {
+  Module() : snort::Module(s_name, s_help, module_params) {
+    LioLi::LogDB::register_type<Logger>();
+  }
+
+  bool set(const char *, snort::Value &, snort::SnortConfig *) override {
+    // fail if we didn't get something valid
+    return false;
+  }
+
+  const PegInfo *get_pegs() const override { return s_pegs; }
+
+  PegCount *get_counts() const override {
+    return reinterpret_cast<PegCount *>(&s_peg_counts);
+  }
+
+  Usage get_usage() const override {
+    return GLOBAL;
+  } // TODO(mkr): Figure out what the usage type means
+
+public:
+  static snort::Module *ctor() { return new Module(); }
+  static void dtor(snort::Module *p) { delete p; }
+};
+
+class Inspector : public snort::Inspector {
+  void eval(snort::Packet *) override{};
+
+  bool configure(snort::SnortConfig *) override {
+    LioLi::LogDB::get<Logger>(s_name)->set_pub_id(
+        snort::DataBus::get_id(LioLi::tree_pub_key));
+    return true;
+  }
+
+public:
+  static snort::Inspector *ctor(snort::Module *) { return new Inspector(); }
+  static void dtor(snort::Inspector *p) { delete p; }
+};
+
+} // namespace
+
+const snort::InspectApi inspect_api = {
+    {
+        PT_INSPECTOR,
+        sizeof(snort::InspectApi),
+        INSAPI_VERSION,
+        0,
+        API_RESERVED,
+        API_OPTIONS,
+        s_name,
+        s_help,
+        Module::ctor,
+        Module::dtor,
+    },
+
+    snort::IT_PASSIVE,
+    PROTO_BIT__NONE,
+    nullptr, // buffers
+    nullptr, // service
+    nullptr, // pinit
+    nullptr, // pterm
+    nullptr, // tinit
+    nullptr, // tterm
+    Inspector::ctor,
+    Inspector::dtor,
+    nullptr, // ssn
+    nullptr  // reset
+};
+
+} // namespace logger_databus
@@ -0,0 +1,18 @@
+#ifndef logger_databus_a7e2f516
+#define logger_databus_a7e2f516
+
+// Snort includes
+#include <framework/base_api.h>
+#include <framework/inspector.h>
+
+// System includes
+
+// Local includes
+
+namespace logger_databus {
+
+extern const snort::InspectApi inspect_api;
+
+} // namespace logger_databus
+
+#endif // #ifndef logger_databus_a7e2f516
@@ -7,11 +7,15 @@
 
 // System includes
 #include <fstream>
+#include <chrono>
 #include <iostream>
+#include <memory>
 #include <mutex>
+#include <string_view>
 
 // Local includes
 #include "lioli.h"
+#include "lioli_block_codec.h"
 #include "log_framework.h"
 #include "logger_file.h"
 
@@ -29,23 +33,75 @@ static const snort::Parameter module_params[] = {
      "File name logs should be written to"},
     {"serializer", snort::Parameter::PT_STRING, nullptr, nullptr,
      "Serializer to use for generating output"},
+    {"templates", snort::Parameter::PT_INT, "0:1000000", "0",
+     "Max number of tree templates remembered, the template of e.g. a flow "
+     "is then only sent once (0 = disabled)"},
+    {"compression", snort::Parameter::PT_ENUM, "none | lz4", "none",
+     "Compress the output in blocks, each framed with length and checksum"},
+    {"compression_level", snort::Parameter::PT_INT, "1:9", "1",
+     "Higher levels compress better, but slower"},
+    {"compression_block_size", snort::Parameter::PT_INT, "1024:4194304",
+     "65536", "Bytes of output compressed together"},
+    {"sync_interval", snort::Parameter::PT_INT, "0:1000000000", "0",
+     "Records between sync blocks, which let readers start decoding after "
+     "any of them (0 = disabled)"},
+    {"sync_index", snort::Parameter::PT_BOOL, nullptr, "false",
+     "Write the offset, records and time range of every sync block to "
+     "<file_name>.idx"},
+    {"sync_time_field", snort::Parameter::PT_STRING, nullptr, "timestamp",
+     "Path below the root to the time of a record (e.g. delta.time), for the "
+     "time range of sync blocks"},
     {nullptr, snort::Parameter::PT_MAX, nullptr, nullptr, nullptr}};
 
+static THREAD_LOCAL LioLi::LoggerStats::PegCounts s_peg_counts;
+
+// Identifies sync blocks, also when the root name isn't serialized
+static const char *s_sync_magic = "sync-8f3c2a71e9b4d605";
+
 // MAIN object of this file
 class Logger : public LioLi::Logger {
   std::mutex mutex; // Protects members
 
   std::string serializer_name;
   std::string file_name;
+  uint32_t max_templates = 0; // 0 = templates disabled
 
   std::shared_ptr<LioLi::Serializer::Context> context;
+
+  // Reused for every tree, so its capacity settles at the largest tree seen
+  std::string output;
   std::ofstream ofile;
 
+  // Only set if compression is enabled
+  std::unique_ptr<LioLi::BlockCodec::Compressor> compressor;
+  std::string compressed;
+
+  // Sync blocks, only used if sync_interval is set. A block is the records
+  // since the previous sync block, summarized by the sync block ending it
+  uint32_t sync_interval = 0;
+  bool sync_index = false;
+  std::string sync_time_field;
+  std::ofstream index_file;
+  uint64_t written = 0;       // Bytes written to the file
+  uint64_t block_offset = 0;  // Where the first record of the block starts
+  uint64_t block_ordinal = 0; // Ordinal of the first record of the block
+  uint32_t block_records = 0;
+  std::string block_first; // Earliest timestamp of the block, empty if none
+  std::string block_last;  // Latest timestamp of the block
+
   LioLi::Serializer::Context &get_context() {
     if (!context) {
       auto serializer = LioLi::LogDB::get<LioLi::Serializer>(serializer_name);
 
-      context = serializer->create_context();
+      context = max_templates
+                    ? serializer->create_templated_context(max_templates)
+                    : serializer->create_context();
+
+      if (sync_interval) {
+        // Any stream header goes before the first block
+        write(context->open());
+        block_offset = written;
+      }
     }
 
     return *context.get();
@@ -57,7 +113,7 @@ class Logger : public LioLi::Logger {
 
       auto serializer = LioLi::LogDB::get<LioLi::Serializer>(serializer_name);
 
-      if (serializer->is_binary()) {
+      if (serializer->is_binary() || compressor) {
         open_mode |= std::ios_base::binary;
       }
 
@@ -67,18 +123,83 @@ class Logger : public LioLi::Logger {
         snort::ErrorMessage("ERROR: Could not open output file %s\n",
                             serializer_name.c_str());
       }
+
+      if (sync_index) {
+        index_file.open(file_name + ".idx");
+        index_file << "# offset length ordinal records first last\n";
+      }
     }
     return ofile;
   }
 
+  // Blocks are only written when full, so output may be held back until the
+  // logger goes down
+  void write(std::string_view data) {
+    if (!compressor) {
+      get_ofile() << data;
+      written += data.size();
+      return;
+    }
+
+    compressed.clear();
+    compressor->write(data, compressed);
+    get_ofile() << compressed;
+  }
+
+  // Widens the time range of the block with the time of tree (if any)
+  void add_to_block(const LioLi::Tree &tree) {
+    auto time = tree.get_value(tree.get_root_name() + "." + sync_time_field);
+
+    if (time && !time->empty()) {
+      // ISO 8601 timestamps in the same zone sort as text
+      if (block_first.empty() || *time < block_first) {
+        block_first = *time;
+      }
+      if (*time > block_last) {
+        block_last = *time;
+      }
+    }
+
+    block_records++;
+  }
+
+  // Ends the current block with a sync block, and adds it to the index
+  void write_sync() {
+    uint64_t length = written - block_offset;
+
+    LioLi::Tree sync("#sync");
+    sync << (LioLi::Tree("magic") << s_sync_magic)
+         << (LioLi::Tree("ordinal") << std::to_string(block_ordinal))
+         << (LioLi::Tree("records") << std::to_string(block_records));
+    if (!block_first.empty()) {
+      sync << (LioLi::Tree("first") << block_first)
+           << (LioLi::Tree("last") << block_last);
+    }
+
+    output.clear();
+    context->serialize_into(std::move(sync), output);
+    write(output);
+
+    if (sync_index) {
+      // The records must be in the file before the index points at them
+      get_ofile().flush();
+      index_file << block_offset << ' ' << length << ' ' << block_ordinal
+                 << ' ' << block_records << ' '
+                 << (block_first.empty() ? "-" : block_first) << ' '
+                 << (block_last.empty() ? "-" : block_last) << std::endl;
+    }
+
+    block_offset = written;
+    block_ordinal += block_records;
+    block_records = 0;
+    block_first.clear();
+    block_last.clear();
+  }
+
 public:
   Logger() : LioLi::Logger(s_name) {}
 
-  ~Logger() {
-    // We can't request a context here, as it isn't safe during shutdown
-    if (context)
-      get_ofile() << context->close();
-  }
+  ~Logger() {}
 
   void set_serializer(const char *name) {
     std::scoped_lock lock(mutex);
@@ -98,24 +219,122 @@ public:
     return true;
   }
 
+  void set_max_templates(uint32_t max) {
+    std::scoped_lock lock(mutex);
+
+    assert(!context); // Only used when the context is created
+    max_templates = max;
+  }
+
+  void set_compression(unsigned level, size_t block_size) {
+    std::scoped_lock lock(mutex);
+
+    assert(!context); // The stream must be compressed from the start
+
+    compressor =
+        std::make_unique<LioLi::BlockCodec::Compressor>(level, block_size);
+  }
+
+  void set_sync(uint32_t interval, bool index, std::string time_field) {
+    std::scoped_lock lock(mutex);
+
+    assert(!context); // Blocks are counted from the start of the file
+
+    sync_interval = interval;
+    sync_index = index;
+    sync_time_field = time_field;
+  }
+
   void operator<<(const LioLi::Tree &&tree) override {
+    using clock = LioLi::LoggerStats::clock;
+    auto enqueued = clock::now();
+
+    std::scoped_lock lock(mutex);
+
+    // The tree is handed to the serializer, so its time is taken before
+    if (sync_interval) {
+      add_to_block(tree);
+    }
+
+    auto serialize_time = clock::now();
+    output.clear();
+    get_context().serialize_into(std::move(tree), output);
+
+    auto write_time = clock::now();
+    write(output);
+
+    get_stats().written(enqueued, serialize_time, write_time, clock::now(),
+                        output.size());
+
+    if (sync_interval && block_records == sync_interval) {
+      write_sync();
+    }
+  }
+
+  // Call to terminate, ends the file with the last sync block and the end of
+  // the stream. Not done in the destructor, as LogDB is destroyed with the
+  // statics, and trees can't be built then
+  void stop() {
     std::scoped_lock lock(mutex);
 
-    get_ofile() << get_context().serialize(std::move(tree));
+    // We can't request a context here, as it isn't safe during shutdown
+    if (!context) {
+      return;
+    }
+
+    if (block_records) {
+      write_sync();
+    }
+    write(context->close());
+
+    if (compressor) {
+      compressed.clear();
+      compressor->close(compressed);
+      get_ofile() << compressed;
+    }
+    get_ofile().flush();
+
+    context.reset();
   }
 };
 
+static int dump_stats(lua_State *L) {
+  LioLi::LogDB::get<Logger>(s_name)->get_stats().respond(L, s_name);
+  return 0;
+}
+
+static const snort::Command s_commands[] = {
+    {"dump_stats", dump_stats, nullptr, "dump latency and size statistics"},
+    {nullptr, nullptr, nullptr, nullptr}};
+
 class Module : public snort::Module {
   Module() : snort::Module(s_name, s_help, module_params) {
     LioLi::LogDB::register_type<Logger>();
   }
 
+  ~Module() {
+    // Write what is held back
+    LioLi::LogDB::get<Logger>(s_name)->stop();
+  }
+
   bool file_name_set = false;
   bool serializer_set = false;
+  bool templates_set = false;
+  bool compression = false;
+  unsigned compression_level = 1;
+  size_t compression_block_size = 65536;
+  uint32_t sync_interval = 0;
+  bool sync_index = false;
+  std::string sync_time_field;
 
   bool begin(const char *, int, snort::SnortConfig *) override {
     file_name_set = false;
     serializer_set = false;
+    templates_set = false;
+    compression = false;
+    sync_interval = 0;
+    sync_index = false;
+    sync_time_field = "timestamp";
     return true;
   }
 
@@ -126,6 +345,33 @@ class Module : public snort::Module {
     if (!serializer_set) {
       snort::ErrorMessage("ERROR: serializer not specified for %s\n", s_name);
     }
+    if (sync_index && !sync_interval) {
+      snort::ErrorMessage("ERROR: sync_index needs a sync_interval in %s\n",
+                          s_name);
+      return false;
+    }
+    if (sync_interval && compression) {
+      // Offsets in the compressed file don't point at records
+      snort::ErrorMessage(
+          "ERROR: sync_interval cannot be combined with compression in %s\n",
+          s_name);
+      return false;
+    }
+    if (sync_interval && templates_set) {
+      // Records after a sync block could refer to templates before it
+      snort::ErrorMessage(
+          "ERROR: sync_interval cannot be combined with templates in %s\n",
+          s_name);
+      return false;
+    }
+    if (file_name_set && serializer_set && compression) {
+      LioLi::LogDB::get<Logger>(s_name)->set_compression(
+          compression_level, compression_block_size);
+    }
+    if (file_name_set && serializer_set && sync_interval) {
+      LioLi::LogDB::get<Logger>(s_name)->set_sync(sync_interval, sync_index,
+                                                  sync_time_field);
+    }
     return file_name_set && serializer_set;
   }
 
@@ -142,6 +388,28 @@ class Module : public snort::Module {
     } else if (val.is("file_name") && val.get_as_string().size() > 0) {
       file_name_set = logger->set_file_name(val.get_string());
 
+      return true;
+    } else if (val.is("templates")) {
+      logger->set_max_templates(val.get_uint32());
+      templates_set = val.get_uint32() > 0;
+      return true;
+    } else if (val.is("compression")) {
+      compression = val.get_uint8() != 0; // 0 = none
+      return true;
+    } else if (val.is("compression_level")) {
+      compression_level = val.get_uint32();
+      return true;
+    } else if (val.is("compression_block_size")) {
+      compression_block_size = val.get_uint32();
+      return true;
+    } else if (val.is("sync_interval")) {
+      sync_interval = val.get_uint32();
+      return true;
+    } else if (val.is("sync_index")) {
+      sync_index = val.get_bool();
+      return true;
+    } else if (val.is("sync_time_field")) {
+      sync_time_field = val.get_string();
       return true;
     }
 
@@ -149,6 +417,17 @@ class Module : public snort::Module {
     return false;
   }
 
+  const PegInfo *get_pegs() const override {
+    return LioLi::LoggerStats::get_pegs();
+  }
+
+  PegCount *get_counts() const override {
+    LioLi::LogDB::get<Logger>(s_name)->get_stats().fill(s_peg_counts);
+    return reinterpret_cast<PegCount *>(&s_peg_counts);
+  }
+
+  const snort::Command *get_commands() const override { return s_commands; }
+
   Usage get_usage() const override {
     return GLOBAL;
   } // TODO(mkr): Figure out what the usage type means
@@ -12,13 +12,22 @@
 #include <deque>
 #include <fstream>
 #include <iostream>
+#include <memory>
 #include <mutex>
+#include <poll.h>
+#include <sstream>
+#include <string_view>
+#include <sys/socket.h>
+#include <sys/un.h>
 #include <thread>
+#include <unistd.h>
 
 // Local includes
 #include "lioli.h"
+#include "lioli_block_codec.h"
 #include "log_framework.h"
 #include "logger_pipe.h"
+#include "replay_window.h"
 
 // Debug includes
 
@@ -40,9 +49,28 @@ static const snort::Parameter module_params[] = {
      "never))"},
     {"serializer", snort::Parameter::PT_STRING, nullptr, nullptr,
      "Serializer to use for generating output"},
+    {"replay_window", snort::Parameter::PT_INT, "0:1000000", "0",
+     "Number of written records kept for replay, enables sequence numbers in "
+     "the output (0 = disabled)"},
+    {"ack_socket", snort::Parameter::PT_STRING, nullptr, nullptr,
+     "Unix socket where consumers can ack records and request resumption, "
+     "needs replay_window. Records are only written after the consumer has "
+     "sent resume on each opening of the pipe"},
+    {"templates", snort::Parameter::PT_INT, "0:1000000", "0",
+     "Max number of tree templates remembered, the template of e.g. a flow "
+     "is then only sent once (0 = disabled)"},
+    {"compression", snort::Parameter::PT_ENUM, "none | lz4", "none",
+     "Compress the output in blocks, each framed with length and checksum"},
+    {"compression_level", snort::Parameter::PT_INT, "1:9", "1",
+     "Higher levels compress better, but slower"},
+    {"compression_block_size", snort::Parameter::PT_INT, "1024:4194304",
+     "65536", "Bytes of output compressed together, a shorter block is "
+     "written whenever the queue runs empty"},
 
     {nullptr, snort::Parameter::PT_MAX, nullptr, nullptr, nullptr}};
 
+static THREAD_LOCAL LioLi::LoggerStats::PegCounts s_peg_counts;
+
 // SIGPIPE handler
 void pipe_signal_handler(int) {}
 
@@ -57,8 +85,23 @@ class Logger : public LioLi::Logger {
   std::string pipe_name;
   uint32_t max_queue_size = 1;
   uint32_t serializer_restart_interval_s = 0; // 0 = never
-
-  std::deque<LioLi::Tree> queue;
+  uint32_t replay_window = 0;                 // 0 = no sequence numbers
+  uint32_t max_templates = 0;                 // 0 = templates disabled
+  std::string ack_socket_name;
+  bool compression = false;
+  unsigned compression_level = 1;
+  size_t compression_block_size = 65536;
+
+  // Trees are timestamped when queued, for the latency statistics
+  struct QueuedTree {
+    LioLi::Tree tree;
+    clock::time_point enqueued;
+  };
+  std::deque<QueuedTree> queue;
+
+  // Resumable delivery, records are kept after being written until they are
+  // acked or pushed out of the window
+  LioLi::ReplayWindow window;
 
   // Worker thread controls
   std::thread worker_thread;
@@ -67,6 +110,8 @@ class Logger : public LioLi::Logger {
   bool terminate = false;     // Set to true if worker loop should be terminated
   bool worker_done = false;   // Worker won't block anymore
 
+  std::thread ack_thread;
+
   std::ofstream open_pipe(std::unique_lock<std::mutex> &lock) {
     assert(serializer_name.length() != 0 && pipe_name.length() != 0);
 
@@ -75,12 +120,20 @@ class Logger : public LioLi::Logger {
 
     std::ios_base::openmode openmode = std::ios::out;
 
-    if (LioLi::LogDB::get<LioLi::Serializer>(serializer_name)->is_binary()) {
+    if (LioLi::LogDB::get<LioLi::Serializer>(serializer_name)->is_binary() ||
+        compression) {
       openmode |= std::ios::binary;
     }
 
     std::string tmp_name = pipe_name;
 
+    // With a side channel the consumer resumes after opening, otherwise the
+    // replay could be written after newer records. Set before the lock is
+    // released, as the resume can arrive as soon as the reader is attached
+    if (!ack_socket_name.empty()) {
+      window.hold();
+    }
+
     // Release the lock while opening, as it will block until a reader is
     // attached to the pipe
     lock.unlock();
@@ -108,22 +161,46 @@ class Logger : public LioLi::Logger {
     // Our serializer
     auto serializer = LioLi::LogDB::get<LioLi::Serializer>(serializer_name);
     std::shared_ptr<LioLi::Serializer::Context> context;
+    std::shared_ptr<LioLi::Serializer::SequencedContext> sequenced_context;
 
     std::ofstream pipe;
 
+    // Reused for every tree, so its capacity settles at the largest tree seen
+    std::string output;
+
+    // Everything written to the pipe goes through here, so compression covers
+    // headers and replays as well as trees
+    std::unique_ptr<LioLi::BlockCodec::Compressor> compressor;
+    std::string compressed;
+    if (compression) {
+      compressor = std::make_unique<LioLi::BlockCodec::Compressor>(
+          compression_level, compression_block_size);
+    }
+    auto encode = [&](std::string_view data) -> std::string_view {
+      if (!compressor) {
+        return data;
+      }
+      compressed.clear();
+      compressor->write(data, compressed);
+      return compressed;
+    };
+
     while (!terminate) {
       if (!pipe.is_open()) {
         // open_pipe will set terminate to true if something went wrong
         pipe = open_pipe(lock);
-        // We always start a new pipe with a fresh context
+        // We always start a new pipe with a fresh context, and stream
         context.reset();
+        if (compressor) {
+          compressor->reset();
+        }
         continue;
       }
 
       if (next_timeout <= clock::now() || !context) {
         if (context) {
           lock.unlock();
-          pipe << context->close();
+          pipe << encode(context->close());
           pipe.flush();
           lock.lock();
 
@@ -135,7 +212,22 @@ class Logger : public LioLi::Logger {
           }
         }
 
-        context = serializer->create_context();
+        if (replay_window) {
+          sequenced_context = serializer->create_sequenced_context();
+          assert(sequenced_context); // Checked when configured
+          context = sequenced_context;
+
+          // A resumed stream must start with a header, as the replayed
+          // records are written before any new tree
+          lock.unlock();
+          pipe << encode(context->open());
+          lock.lock();
+        } else if (max_templates) {
+          context = serializer->create_templated_context(max_templates);
+        } else {
+          context = serializer->create_context();
+        }
+
         if (serializer_restart_interval_s != 0) {
           next_timeout = clock::now() +
                          std::chrono::seconds(serializer_restart_interval_s);
@@ -144,13 +236,42 @@ class Logger : public LioLi::Logger {
         }
       }
 
-      if (!queue.empty()) {
-        auto output = context->serialize(std::move(queue.front()));
+      if (window.has_replay()) {
+        std::string replay = window.take_replay();
+
+        lock.unlock();
+        pipe << encode(replay);
+        lock.lock();
+
+        if (!pipe.good()) {
+          snort::LogMessage("LOG: %s unable to replay to pipe, retrying\n",
+                            s_name);
+          pipe.close();
+          continue;
+        }
+      }
+
+      if (!queue.empty() && !window.is_holding()) {
+        output.clear();
+        auto enqueued = queue.front().enqueued;
+        auto serialize_time = clock::now();
+
+        if (replay_window) {
+          uint64_t sequence = window.next_sequence();
+          output = sequenced_context->serialize_sequenced(
+              std::move(queue.front().tree), sequence);
+          // Stored before writing, so a failed write can be resumed
+          window.add(sequence, output);
+        } else {
+          context->serialize_into(std::move(queue.front().tree), output);
+        }
         queue.pop_front();
+        get_stats().set_queue_depth(queue.size());
 
         // We can't write while being locked, as the write might block
+        auto write_time = clock::now();
         lock.unlock();
-        pipe << output;
+        pipe << encode(output);
         lock.lock();
 
         if (!pipe.good()) {
@@ -160,16 +281,50 @@ class Logger : public LioLi::Logger {
           pipe.close();
           continue;
         }
+
+        get_stats().written(enqueued, serialize_time, write_time, clock::now(),
+                            output.size());
       }
 
-      if (!terminate && queue.empty()) {
+      if (!terminate && !has_work()) {
+        // Don't keep the consumer waiting for a full block
+        if (compressor) {
+          compressed.clear();
+          compressor->flush(compressed);
+
+          if (!compressed.empty()) {
+            lock.unlock();
+            pipe << compressed;
+            pipe.flush();
+            lock.lock();
+
+            if (!pipe.good()) {
+              snort::LogMessage("LOG: %s unable to write block to pipe, "
+                                "retrying\n",
+                                s_name);
+              pipe.close();
+              continue;
+            }
+          }
+
+          // The lock was released, so there might be new work
+          if (terminate || has_work()) {
+            continue;
+          }
+        }
+
         cv.wait_until(lock, next_timeout);
       }
     }
 
     if (pipe.good() && pipe.is_open() && context) {
       lock.unlock();
-      pipe << context->close();
+      pipe << encode(context->close());
+      if (compressor) {
+        compressed.clear();
+        compressor->close(compressed);
+        pipe << compressed;
+      }
       lock.lock();
       pipe.close();
     }
@@ -179,6 +334,124 @@ class Logger : public LioLi::Logger {
     cv.notify_all();
   }
 
+  // Must be called with mutex taken, true if there is something to write
+  bool has_work() {
+    return window.has_replay() || (!queue.empty() && !window.is_holding());
+  }
+
+  // Handles a single command from the side channel, returns the reply
+  //   ack <seq>    - records up to and including seq can be released
+  //   resume <seq> - replay records after seq, reply is the first sequence
+  //                  number that will be sent, a gap means records were lost.
+  //                  Must be sent after each opening of the pipe (seq 0 if
+  //                  nothing has been received), new records are held until
+  //                  then. Sent on an open stream, records already received
+  //                  are written again, after the newer ones
+  std::string handle_command(const std::string &line) {
+    std::istringstream is(line);
+    std::string command;
+    uint64_t sequence = 0;
+
+    if (!(is >> command >> sequence)) {
+      return "error\n";
+    }
+
+    std::scoped_lock lock(mutex);
+
+    if (command == "ack") {
+      window.ack(sequence);
+      return "ok\n";
+    } else if (command == "resume") {
+      uint64_t first = window.resume(sequence);
+
+      cv.notify_all();
+      return "resume " + std::to_string(first) + "\n";
+    }
+
+    return "error\n";
+  }
+
+  // Serves the side channel, one consumer at a time
+  void ack_loop() {
+    int server = socket(AF_UNIX, SOCK_STREAM, 0);
+    sockaddr_un addr = {};
+    addr.sun_family = AF_UNIX;
+
+    if (server < 0 || ack_socket_name.size() >= sizeof(addr.sun_path)) {
+      snort::ErrorMessage("ERROR: %s could not create ack socket %s\n", s_name,
+                          ack_socket_name.c_str());
+      if (server >= 0) {
+        close(server);
+      }
+      return;
+    }
+
+    ack_socket_name.copy(addr.sun_path, sizeof(addr.sun_path) - 1);
+    unlink(ack_socket_name.c_str());
+
+    if (bind(server, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) != 0 ||
+        listen(server, 1) != 0) {
+      snort::ErrorMessage("ERROR: %s could not bind ack socket %s\n", s_name,
+                          ack_socket_name.c_str());
+      close(server);
+      return;
+    }
+
+    auto stopping = [this]() {
+      std::scoped_lock lock(mutex);
+      return terminate;
+    };
+
+    // Polls with a timeout, so termination is noticed
+    auto wait_readable = [](int fd) {
+      pollfd pfd = {fd, POLLIN, 0};
+      return poll(&pfd, 1, 250) > 0;
+    };
+
+    while (!stopping()) {
+      if (!wait_readable(server)) {
+        continue;
+      }
+
+      int client = accept(server, nullptr, nullptr);
+      if (client < 0) {
+        continue;
+      }
+
+      std::string buffer;
+      bool connected = true;
+
+      while (connected && !stopping()) {
+        if (!wait_readable(client)) {
+          continue;
+        }
+
+        char data[256];
+        ssize_t length = read(client, data, sizeof(data));
+        if (length <= 0) {
+          break;
+        }
+        buffer.append(data, length);
+
+        size_t eol;
+        while ((eol = buffer.find('\n')) != buffer.npos) {
+          std::string reply = handle_command(buffer.substr(0, eol));
+          buffer.erase(0, eol + 1);
+
+          if (write(client, reply.data(), reply.size()) < 0) {
+            connected = false;
+            break;
+          }
+        }
+      }
+
+      close(client);
+    }
+
+    close(server);
+    unlink(ack_socket_name.c_str());
+  }
+
 public:
   Logger() : LioLi::Logger(s_name) {
     // A SIGPIPE will fire if we are trying to write to a pipe without a reader,
@@ -201,7 +474,8 @@ public:
         queue.pop_front();
       }
 
-      queue.push_back(std::move(tree));
+      queue.push_back({std::move(tree), clock::now()});
+      get_stats().enqueued(queue.size());
     }
 
     // Kick worker
@@ -241,10 +515,48 @@ public:
     while (queue.size() > max) {
       queue.pop_front();
     }
+    get_stats().set_queue_depth(queue.size());
 
     max_queue_size = max;
   }
 
+  void set_replay_window(uint32_t size) {
+    std::scoped_lock lock(mutex);
+
+    replay_window = size;
+    window.set_max_records(replay_window);
+  }
+
+  void set_ack_socket_name(std::string name) {
+    std::scoped_lock lock(mutex);
+
+    assert(ack_socket_name.empty() ||
+           name == ack_socket_name); // We do not handle changing of the name
+
+    ack_socket_name = name;
+  }
+
+  void set_max_templates(uint32_t max) {
+    std::scoped_lock lock(mutex);
+
+    max_templates = max;
+  }
+
+  void set_compression(unsigned level, size_t block_size) {
+    std::scoped_lock lock(mutex);
+
+    compression = true;
+    compression_level = level;
+    compression_block_size = block_size;
+  }
+
+  bool is_replay_supported() {
+    std::scoped_lock lock(mutex);
+
+    return LioLi::LogDB::get<LioLi::Serializer>(serializer_name)
+        ->has_sequence_support();
+  }
+
   void set_serializer_restart_interval_s(uint32_t interval) {
     {
       std::scoped_lock lock(mutex);
@@ -260,10 +572,23 @@ public:
     terminate = false;
     worker_done = false;
     worker_thread = std::thread{&Logger::worker_loop, this};
+
+    if (!ack_socket_name.empty()) {
+      ack_thread = std::thread{&Logger::ack_loop, this};
+    }
   }
 
   // Call to terminate
   void stop() {
+    // The side channel polls terminate, so it will go down by itself
+    if (ack_thread.joinable()) {
+      {
+        std::scoped_lock lock(mutex);
+        terminate = true;
+      }
+      ack_thread.join();
+    }
+
     // Check worker is running
     if (worker_thread.joinable()) {
       std::unique_lock lock(mutex);
@@ -295,6 +620,15 @@ public:
   }
 };
 
+static int dump_stats(lua_State *L) {
+  LioLi::LogDB::get<Logger>(s_name)->get_stats().respond(L, s_name);
+  return 0;
+}
+
+static const snort::Command s_commands[] = {
+    {"dump_stats", dump_stats, nullptr, "dump latency and size statistics"},
+    {nullptr, nullptr, nullptr, nullptr}};
+
 class Module : public snort::Module {
   Module() : snort::Module(s_name, s_help, module_params) {
     LioLi::LogDB::register_type<Logger>();
@@ -307,10 +641,20 @@ class Module : public snort::Module {
 
   bool pipe_name_set = false;
   bool serializer_set = false;
+  bool replay_set = false;
+  bool ack_socket_set = false;
+  bool templates_set = false;
+  bool compression = false;
+  unsigned compression_level = 1;
+  size_t compression_block_size = 65536;
 
   bool begin(const char *, int, snort::SnortConfig *) override {
     pipe_name_set = false;
     serializer_set = false;
+    replay_set = false;
+    ack_socket_set = false;
+    templates_set = false;
+    compression = false;
 
     return true;
   }
@@ -322,8 +666,33 @@ class Module : public snort::Module {
     if (!serializer_set) {
       snort::ErrorMessage("ERROR: no serializer specified for %s\n", s_name);
     }
+    if (ack_socket_set && !replay_set) {
+      snort::ErrorMessage("ERROR: ack_socket needs a replay_window in %s\n",
+                          s_name);
+      return false;
+    }
+    if (replay_set && templates_set) {
+      // Replayed records could refer to templates the consumer never got
+      snort::ErrorMessage(
+          "ERROR: templates cannot be combined with replay_window in %s\n",
+          s_name);
+      return false;
+    }
+    if (replay_set && serializer_set &&
+        !LioLi::LogDB::get<Logger>(s_name)->is_replay_supported()) {
+      snort::ErrorMessage(
+          "ERROR: serializer does not support sequence numbers needed by "
+          "replay_window in %s\n",
+          s_name);
+      return false;
+    }
 
     if (pipe_name_set && serializer_set) {
+      if (compression) {
+        LioLi::LogDB::get<Logger>(s_name)->set_compression(
+            compression_level, compression_block_size);
+      }
+
       // Start worker
       LioLi::LogDB::get<Logger>(s_name)->start();
       return true;
@@ -383,6 +752,29 @@ class Module : public snort::Module {
 
       LioLi::LogDB::get<Logger>(s_name)->set_max_queue_size(val.get_uint32());
       return true;
+    } else if (val.is("replay_window")) {
+      // Has a default value, so it is always set
+      LioLi::LogDB::get<Logger>(s_name)->set_replay_window(val.get_uint32());
+      replay_set = val.get_uint32() > 0;
+      return true;
+    } else if (val.is("ack_socket") && val.get_as_string().size() > 0) {
+      LioLi::LogDB::get<Logger>(s_name)->set_ack_socket_name(val.get_string());
+      ack_socket_set = true;
+      return true;
+    } else if (val.is("templates")) {
+      // Has a default value, so it is always set
+      LioLi::LogDB::get<Logger>(s_name)->set_max_templates(val.get_uint32());
+      templates_set = val.get_uint32() > 0;
+      return true;
+    } else if (val.is("compression")) {
+      compression = val.get_uint8() != 0; // 0 = none
+      return true;
+    } else if (val.is("compression_level")) {
+      compression_level = val.get_uint32();
+      return true;
+    } else if (val.is("compression_block_size")) {
+      compression_block_size = val.get_uint32();
+      return true;
     } else if (val.is("restart_interval_s")) {
       LioLi::LogDB::get<Logger>(s_name)->set_serializer_restart_interval_s(
           val.get_uint32());
@@ -393,6 +785,17 @@ class Module : public snort::Module {
     return false;
   }
 
+  const PegInfo *get_pegs() const override {
+    return LioLi::LoggerStats::get_pegs();
+  }
+
+  PegCount *get_counts() const override {
+    LioLi::LogDB::get<Logger>(s_name)->get_stats().fill(s_peg_counts);
+    return reinterpret_cast<PegCount *>(&s_peg_counts);
+  }
+
+  const snort::Command *get_commands() const override { return s_commands; }
+
   Usage get_usage() const override {
     return GLOBAL;
   } // TODO(mkr): Figure out what the usage type means
@@ -0,0 +1,362 @@
+
+// Snort includes
+#include <framework/counts.h>
+#include <framework/decode_data.h>
+#include <framework/inspector.h>
+#include <framework/module.h>
+#include <log/messages.h>
+
+// System includes
+#include <algorithm>
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+// Local includes
+#include "lioli.h"
+#include "lioli_path.h"
+#include "log_framework.h"
+#include "logger_ratelimit.h"
+
+// Debug includes
+
+namespace logger_ratelimit {
+namespace {
+
+static const char *s_name = "logger_ratelimit";
+static const char *s_help =
+    "Rate limits LioLi trees with token buckets keyed by a path value, before "
+    "passing them on to another logger";
+
+static const snort::Parameter module_params[] = {
+    {"logger", snort::Parameter::PT_STRING, nullptr, nullptr,
+     "Logger trees within the rate limit should be sent to"},
+    {"key_path", snort::Parameter::PT_STRING, nullptr, nullptr,
+     "Path of the node whose value selects the bucket, e.g. $.alert"},
+    {"rate", snort::Parameter::PT_INT, "0:1000000", "100",
+     "Trees per second added to each bucket (0 = never refill)"},
+    {"burst", snort::Parameter::PT_INT, "1:1000000", "100",
+     "Max number of trees a bucket can hold"},
+    {"max_buckets", snort::Parameter::PT_INT, "1:1000000", "4096",
+     "Max number of keyed buckets, new keys beyond this share one bucket"},
+    {nullptr, snort::Parameter::PT_MAX, nullptr, nullptr, nullptr}};
+
+// This must match the s_pegs[] array
+struct PegCounts {
+  PegCount passed = 0;
+  PegCount dropped_keyed = 0;
+  PegCount dropped_no_key = 0;
+  PegCount dropped_overflow = 0;
+};
+
+static THREAD_LOCAL PegCounts s_peg_counts;
+
+const PegInfo s_pegs[] = {
+    {CountType::SUM, "passed", "Trees passed on to the logger"},
+    {CountType::SUM, "dropped_keyed", "Trees dropped by a keyed bucket"},
+    {CountType::SUM, "dropped_no_key",
+     "Trees without the key path dropped by the shared no-key bucket"},
+    {CountType::SUM, "dropped_overflow",
+     "Trees dropped by the shared bucket used when max_buckets is reached"},
+    {CountType::END, nullptr, nullptr}};
+
+// Compile time sanity check of number of entries in s_pegs and s_peg_counts
+static_assert(
+    (sizeof(s_pegs) / sizeof(PegInfo)) - 1 ==
+        sizeof(PegCounts) / sizeof(PegCount),
+    "Entries in s_pegs doesn't match number of entries in s_peg_counts");
+
+// MAIN object of this file
+class Logger : public LioLi::Logger {
+  using clock = std::chrono::steady_clock;
+
+  struct Bucket {
+    double tokens = 0;
+    clock::time_point last;
+  };
+
+  // Allows looking up buckets by string_view, so no key copy is made for
+  // trees that hit an existing bucket
+  struct KeyHash {
+    using is_transparent = void;
+    size_t operator()(std::string_view key) const {
+      return std::hash<std::string_view>{}(key);
+    }
+  };
+
+  std::mutex mutex; // Protects members
+
+  // Configs
+  std::string logger_name;
+  std::string key_path;
+  uint32_t rate = 100;
+  uint32_t burst = 100;
+  uint32_t max_buckets = 4096;
+
+  // Resolved when configured, so no LogDB lookup is done per tree
+  std::shared_ptr<LioLi::Logger> logger = LioLi::Logger::get_null_obj();
+
+  std::unordered_map<std::string, Bucket, KeyHash, std::equal_to<>> buckets;
+  Bucket no_key_bucket;
+  Bucket overflow_bucket;
+  bool shared_buckets_init = false;
+  clock::time_point next_eviction;
+
+  // Adds the tokens earned since last visit, returns the new token count
+  double refill(Bucket &bucket, clock::time_point now) {
+    std::chrono::duration<double> elapsed = now - bucket.last;
+    bucket.tokens =
+        std::min<double>(burst, bucket.tokens + rate * elapsed.count());
+    bucket.last = now;
+    return bucket.tokens;
+  }
+
+  bool take(Bucket &bucket, clock::time_point now) {
+    if (refill(bucket, now) < 1.0) {
+      return false;
+    }
+    bucket.tokens -= 1.0;
+    return true;
+  }
+
+  // Buckets that have been refilled to burst are equal to new ones, so they
+  // can be dropped to make room. This is O(n) so it is done at most once a
+  // second
+  void evict_idle(clock::time_point now) {
+    if (now < next_eviction) {
+      return;
+    }
+    next_eviction = now + std::chrono::seconds(1);
+
+    for (auto itr = buckets.begin(); itr != buckets.end();) {
+      if (refill(itr->second, now) >= burst) {
+        itr = buckets.erase(itr);
+      } else {
+        itr++;
+      }
+    }
+  }
+
+  // Must be called with mutex taken
+  bool admit(const LioLi::Tree &tree) {
+    auto now = clock::now();
+
+    if (!shared_buckets_init) {
+      no_key_bucket = {static_cast<double>(burst), now};
+      overflow_bucket = {static_cast<double>(burst), now};
+      shared_buckets_init = true;
+    }
+
+    auto key = tree.get_value(key_path);
+
+    if (!key) {
+      if (take(no_key_bucket, now)) {
+        return true;
+      }
+      s_peg_counts.dropped_no_key++;
+      return false;
+    }
+
+    auto itr = buckets.find(*key);
+
+    if (itr == buckets.end()) {
+      if (buckets.size() >= max_buckets) {
+        evict_idle(now);
+      }
+
+      if (buckets.size() >= max_buckets) {
+        if (take(overflow_bucket, now)) {
+          return true;
+        }
+        s_peg_counts.dropped_overflow++;
+        return false;
+      }
+
+      itr = buckets
+                .emplace(std::string(*key),
+                         Bucket{static_cast<double>(burst), now})
+                .first;
+    }
+
+    if (take(itr->second, now)) {
+      return true;
+    }
+    s_peg_counts.dropped_keyed++;
+    return false;
+  }
+
+public:
+  Logger() : LioLi::Logger(s_name) {}
+
+  ~Logger() {}
+
+  void operator<<(const LioLi::Tree &&tree) override {
+    LioLi::Logger *target;
+    {
+      std::scoped_lock lock(mutex);
+
+      if (!admit(tree)) {
+        return;
+      }
+
+      target = logger.get();
+    }
+
+    s_peg_counts.passed++;
+
+    // Next logger does its own locking
+    *target << std::move(tree);
+  }
+
+  void set_logger(const char *name) {
+    std::scoped_lock lock(mutex);
+
+    logger_name = name;
+    logger = LioLi::LogDB::get<LioLi::Logger>(logger_name);
+  }
+
+  void set_key_path(std::string path) {
+    std::scoped_lock lock(mutex);
+
+    key_path = path;
+    buckets.clear();
+  }
+
+  void set_rate(uint32_t value) {
+    std::scoped_lock lock(mutex);
+    rate = value;
+  }
+
+  void set_burst(uint32_t value) {
+    std::scoped_lock lock(mutex);
+    burst = value;
+  }
+
+  void set_max_buckets(uint32_t value) {
+    std::scoped_lock lock(mutex);
+    max_buckets = value;
+  }
+};
+
+class Module : public snort::Module {
+  Module() : snort::Module(s_name, s_help, module_params) {
+    LioLi::LogDB::register_type<Logger>();
+  }
+
+  bool logger_set = false;
+  bool key_path_set = false;
+
+  bool begin(const char *, int, snort::SnortConfig *) override {
+    logger_set = false;
+    key_path_set = false;
+    return true;
+  }
+
+  bool end(const char *, int, snort::SnortConfig *) override {
+    if (!logger_set) {
+      snort::ErrorMessage("ERROR: no logger specified for %s\n", s_name);
+    }
+    if (!key_path_set) {
+      snort::ErrorMessage("ERROR: no key_path specified for %s\n", s_name);
+    }
+    return logger_set && key_path_set;
+  }
+
+  bool set(const char *, snort::Value &val, snort::SnortConfig *) override {
+    auto logger = LioLi::LogDB::get<Logger>(s_name);
+    assert(logger); // Something went very wrong, if we can't find our self
+
+    if (val.is("logger") && val.get_as_string().size() > 0) {
+      if (val.get_as_string() == s_name) {
+        snort::ErrorMessage("ERROR: %s can't log to itself\n", s_name);
+        return false;
+      }
+
+      logger->set_logger(val.get_string());
+      logger_set = true;
+
+      return true;
+    } else if (val.is("key_path")) {
+      std::string path = val.get_as_string();
+
+      if (!LioLi::Path::is_valid_path_name(path)) {
+        snort::ErrorMessage("ERROR: %s is not a valid LioLi path in %s\n",
+                            path.c_str(), s_name);
+        return false;
+      }
+
+      logger->set_key_path(path);
+      key_path_set = true;
+
+      return true;
+    } else if (val.is("rate")) {
+      logger->set_rate(val.get_uint32());
+      return true;
+    } else if (val.is("burst")) {
+      logger->set_burst(val.get_uint32());
+      return true;
+    } else if (val.is("max_buckets")) {
+      logger->set_max_buckets(val.get_uint32());
+      return true;
+    }
+
+    // fail if we didn't get something valid
+    return false;
+  }
+
+  const PegInfo *get_pegs() const override { return s_pegs; }
+
+  PegCount *get_counts() const override {
+    return reinterpret_cast<PegCount *>(&s_peg_counts);
+  }
+
+  Usage get_usage() const override {
+    return GLOBAL;
+  } // TODO(mkr): Figure out what the usage type means
+
+public:
+  static snort::Module *ctor() { return new Module(); }
+  static void dtor(snort::Module *p) { delete p; }
+};
+
+class Inspector : public snort::Inspector {
+  void eval(snort::Packet *) override{};
+
+public:
+  static snort::Inspector *ctor(snort::Module *) { return new Inspector(); }
+  static void dtor(snort::Inspector *p) { delete p; }
+};
+
+} // namespace
+
+const snort::InspectApi inspect_api = {
+    {
+        PT_INSPECTOR,
+        sizeof(snort::InspectApi),
+        INSAPI_VERSION,
+        0,
+        API_RESERVED,
+        API_OPTIONS,
+        s_name,
+        s_help,
+        Module::ctor,
+        Module::dtor,
+    },
+
+    snort::IT_PASSIVE,
+    PROTO_BIT__NONE,
+    nullptr, // buffers
+    nullptr, // service
+    nullptr, // pinit
+    nullptr, // pterm
+    nullptr, // tinit
+    nullptr, // tterm
+    Inspector::ctor,
+    Inspector::dtor,
+    nullptr, // ssn
+    nullptr  // reset
+};
+
+} // namespace logger_ratelimit
@@ -0,0 +1,18 @@
+#ifndef logger_ratelimit_5c1e9a73
+#define logger_ratelimit_5c1e9a73
+
+// Snort includes
+#include <framework/base_api.h>
+#include <framework/inspector.h>
+
+// System includes
+
+// Local includes
+
+namespace logger_ratelimit {
+
+extern const snort::InspectApi inspect_api;
+
+} // namespace logger_ratelimit
+
+#endif // #ifndef logger_ratelimit_5c1e9a73
@@ -0,0 +1,178 @@
+
+// Snort includes
+#include <control/control.h>
+#include <log/messages.h>
+
+// System includes
+#include <algorithm>
+#include <bit>
+#include <format>
+
+// Local includes
+#include "logger_stats.h"
+
+namespace LioLi {
+
+namespace {
+
+const PegInfo s_pegs[] = {
+    {CountType::MAX, "trees_written", "Trees written by the logger"},
+    {CountType::MAX, "bytes_written", "Serialized bytes written"},
+    {CountType::MAX, "bytes_per_s", "Serialized bytes/s since first write"},
+    {CountType::MAX, "queue_depth", "Trees waiting to be written"},
+    {CountType::MAX, "queue_depth_max", "Max trees waiting to be written"},
+    {CountType::MAX, "total_p50_us", "Median enqueue to written latency"},
+    {CountType::MAX, "total_p99_us", "p99 enqueue to written latency"},
+    {CountType::MAX, "total_p999_us", "p99.9 enqueue to written latency"},
+    {CountType::MAX, "wait_p99_us", "p99 enqueue to serialize latency"},
+    {CountType::MAX, "serialize_p99_us", "p99 serialize to write latency"},
+    {CountType::MAX, "write_p99_us", "p99 write to written latency"},
+    {CountType::MAX, "tree_size_p50", "Median serialized bytes per tree"},
+    {CountType::MAX, "tree_size_p99", "p99 serialized bytes per tree"},
+    {CountType::END, nullptr, nullptr}};
+
+// Compile time sanity check of number of entries in s_pegs and PegCounts
+static_assert(
+    (sizeof(s_pegs) / sizeof(PegInfo)) - 1 ==
+        sizeof(LoggerStats::PegCounts) / sizeof(PegCount),
+    "Entries in s_pegs doesn't match number of entries in PegCounts");
+
+uint64_t as_us(LoggerStats::clock::duration duration) {
+  auto us = std::chrono::duration_cast<std::chrono::microseconds>(duration);
+  return us.count() > 0 ? us.count() : 0;
+}
+
+} // namespace
+
+unsigned Histogram::index_of(uint64_t value) {
+  if (value < sub_count) {
+    return value;
+  }
+
+  // Values in [2^e, 2^(e+1)) are split into sub_count linear buckets
+  unsigned shift = std::bit_width(value) - 1 - sub_bits;
+  unsigned sub = (value >> shift) - sub_count;
+  return (shift + 1) * sub_count + sub;
+}
+
+uint64_t Histogram::upper_bound_of(unsigned index) {
+  if (index < sub_count) {
+    return index;
+  }
+
+  unsigned shift = index / sub_count - 1;
+  uint64_t sub = index % sub_count + sub_count;
+  return ((sub + 1) << shift) - 1;
+}
+
+void Histogram::record(uint64_t value) {
+  buckets[index_of(value)].fetch_add(1, std::memory_order_relaxed);
+  count.fetch_add(1, std::memory_order_relaxed);
+}
+
+uint64_t Histogram::percentile(double p) const {
+  uint64_t total = get_count();
+  if (total == 0) {
+    return 0;
+  }
+
+  uint64_t target = std::min<uint64_t>(p * total, total - 1);
+  uint64_t seen = 0;
+  for (unsigned i = 0; i < bucket_count; i++) {
+    seen += buckets[i].load(std::memory_order_relaxed);
+    if (seen > target) {
+      return upper_bound_of(i);
+    }
+  }
+
+  // Buckets and count are updated independently, so we might not reach it
+  return upper_bound_of(bucket_count - 1);
+}
+
+void LoggerStats::enqueued(size_t depth) {
+  set_queue_depth(depth);
+
+  uint64_t max = queue_depth_max.load(std::memory_order_relaxed);
+  while (depth > max && !queue_depth_max.compare_exchange_weak(
+                            max, depth, std::memory_order_relaxed)) {
+  }
+}
+
+void LoggerStats::set_queue_depth(size_t depth) {
+  queue_depth.store(depth, std::memory_order_relaxed);
+}
+
+void LoggerStats::written(clock::time_point enqueue,
+                          clock::time_point serialize, clock::time_point write,
+                          clock::time_point done, size_t bytes) {
+  wait.record(as_us(serialize - enqueue));
+  this->serialize.record(as_us(write - serialize));
+  this->write.record(as_us(done - write));
+  total.record(as_us(done - enqueue));
+  tree_size.record(bytes);
+
+  trees_written.fetch_add(1, std::memory_order_relaxed);
+  bytes_written.fetch_add(bytes, std::memory_order_relaxed);
+
+  clock::rep unset = 0;
+  first_write.compare_exchange_strong(unset, done.time_since_epoch().count(),
+                                      std::memory_order_relaxed);
+}
+
+const PegInfo *LoggerStats::get_pegs() { return s_pegs; }
+
+void LoggerStats::fill(PegCounts &counts) const {
+  counts.trees_written = trees_written.load(std::memory_order_relaxed);
+  counts.bytes_written = bytes_written.load(std::memory_order_relaxed);
+
+  auto first = first_write.load(std::memory_order_relaxed);
+  auto elapsed = std::chrono::duration_cast<std::chrono::seconds>(
+      clock::now() - clock::time_point(clock::duration(first)));
+  counts.bytes_per_s = (first && elapsed.count() > 0)
+                           ? counts.bytes_written / elapsed.count()
+                           : counts.bytes_written;
+
+  counts.queue_depth = queue_depth.load(std::memory_order_relaxed);
+  counts.queue_depth_max = queue_depth_max.load(std::memory_order_relaxed);
+  counts.total_p50_us = total.percentile(0.5);
+  counts.total_p99_us = total.percentile(0.99);
+  counts.total_p999_us = total.percentile(0.999);
+  counts.wait_p99_us = wait.percentile(0.99);
+  counts.serialize_p99_us = serialize.percentile(0.99);
+  counts.write_p99_us = write.percentile(0.99);
+  counts.tree_size_p50 = tree_size.percentile(0.5);
+  counts.tree_size_p99 = tree_size.percentile(0.99);
+}
+
+std::string LoggerStats::dump(const char *name) const {
+  PegCounts counts;
+  fill(counts);
+
+  std::string output = std::format(
+      "{}: trees: {} bytes: {} bytes/s: {} queue depth: {} (max {})\n", name,
+      counts.trees_written, counts.bytes_written, counts.bytes_per_s,
+      counts.queue_depth, counts.queue_depth_max);
+
+  auto line = [&](const char *stage, const Histogram &histogram,
+                  const char *unit) {
+    output += std::format("  {:<10} p50: {}{} p99: {}{} p999: {}{}\n", stage,
+                          histogram.percentile(0.5), unit,
+                          histogram.percentile(0.99), unit,
+                          histogram.percentile(0.999), unit);
+  };
+
+  line("wait", wait, "us");
+  line("serialize", serialize, "us");
+  line("write", write, "us");
+  line("total", total, "us");
+  line("tree size", tree_size, "B");
+
+  return output;
+}
+
+void LoggerStats::respond(lua_State *L, const char *name) const {
+  snort::ControlConn *ctrlcon = snort::ControlConn::query_from_lua(L);
+  snort::LogRespond(ctrlcon, "%s", dump(name).c_str());
+}
+
+} // namespace LioLi
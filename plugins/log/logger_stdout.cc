@@ -6,6 +6,7 @@
 #include <log/messages.h>
 
 // System includes
+#include <chrono>
 #include <iostream>
 #include <mutex>
 
@@ -28,6 +29,8 @@ static const snort::Parameter module_params[] = {
      "Serializer to use for generating output"},
     {nullptr, snort::Parameter::PT_MAX, nullptr, nullptr, nullptr}};
 
+static THREAD_LOCAL LioLi::LoggerStats::PegCounts s_peg_counts;
+
 // MAIN object of this file
 class Logger : public LioLi::Logger {
   std::mutex mutex; // Protects members
@@ -36,6 +39,9 @@ class Logger : public LioLi::Logger {
 
   std::shared_ptr<LioLi::Serializer::Context> context;
 
+  // Reused for every tree, so its capacity settles at the largest tree seen
+  std::string output;
+
   LioLi::Serializer::Context &get_context() {
     if (!context) {
       auto serializer = LioLi::LogDB::get<LioLi::Serializer>(serializer_name);
@@ -75,12 +81,32 @@ public:
   }
 
   void operator<<(const LioLi::Tree &&tree) override {
+    using clock = LioLi::LoggerStats::clock;
+    auto enqueued = clock::now();
+
     std::scoped_lock lock(mutex);
 
-    std::cout << get_context().serialize(std::move(tree));
+    auto serialize_time = clock::now();
+    output.clear();
+    get_context().serialize_into(std::move(tree), output);
+
+    auto write_time = clock::now();
+    std::cout << output;
+
+    get_stats().written(enqueued, serialize_time, write_time, clock::now(),
+                        output.size());
   }
 };
 
+static int dump_stats(lua_State *L) {
+  LioLi::LogDB::get<Logger>(s_name)->get_stats().respond(L, s_name);
+  return 0;
+}
+
+static const snort::Command s_commands[] = {
+    {"dump_stats", dump_stats, nullptr, "dump latency and size statistics"},
+    {nullptr, nullptr, nullptr, nullptr}};
+
 class Module : public snort::Module {
   Module() : snort::Module(s_name, s_help, module_params) {
     LioLi::LogDB::register_type<Logger>();
@@ -114,6 +140,17 @@ class Module : public snort::Module {
     return false;
   }
 
+  const PegInfo *get_pegs() const override {
+    return LioLi::LoggerStats::get_pegs();
+  }
+
+  PegCount *get_counts() const override {
+    LioLi::LogDB::get<Logger>(s_name)->get_stats().fill(s_peg_counts);
+    return reinterpret_cast<PegCount *>(&s_peg_counts);
+  }
+
+  const snort::Command *get_commands() const override { return s_commands; }
+
   Usage get_usage() const override {
     return GLOBAL;
   } // TODO(mkr): Figure out what the usage type means
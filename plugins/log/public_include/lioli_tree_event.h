@@ -0,0 +1,41 @@
+#ifndef lioli_tree_event_3b9d0c41
+#define lioli_tree_event_3b9d0c41
+
+// Snort includes
+#include <framework/data_bus.h>
+
+// System includes
+
+// Local includes
+#include "lioli.h"
+
+namespace LioLi {
+
+// Trees logged to logger_databus are published under this key, in-process
+// consumers subscribe when their inspector is configured, with:
+//
+//   snort::DataBus::subscribe_global(LioLi::tree_pub_key,
+//                                    LioLi::TreeEventIds::TREE,
+//                                    new MyHandler(), *sc);
+//
+// and get the tree by const reference from the TreeEvent, the tree is only
+// valid for the duration of the handle() call. lioli_tree_logger is such a
+// consumer
+struct TreeEventIds {
+  enum : unsigned { TREE, num_ids };
+};
+
+extern const snort::PubKey tree_pub_key;
+
+class TreeEvent : public snort::DataEvent {
+  const Tree &tree;
+
+public:
+  TreeEvent(const Tree &tree) : tree(tree) {}
+
+  const Tree &get_tree() const { return tree; }
+};
+
+} // namespace LioLi
+
+#endif // #ifndef lioli_tree_event_3b9d0c41
@@ -6,6 +6,8 @@
 
 // System includes
 #include <atomic>
+#include <cassert>
+#include <cstdint>
 #include <map>
 #include <memory>
 #include <mutex>
@@ -13,6 +15,7 @@
 
 // Local includes
 #include "lioli.h"
+#include "logger_stats.h"
 
 // Debug includes
 
@@ -77,6 +80,16 @@ public:
     // might return an empty object
     virtual std::string serialize(const Tree &&) = 0;
 
+    // As serialize(), but appends the byte sequence to out, so a logger can
+    // reuse one buffer for all trees
+    virtual void serialize_into(const Tree &&tree, std::string &out) {
+      out += serialize(std::move(tree));
+    }
+
+    // Returns the stream header (if any) without serializing a tree, so a
+    // stream can be (re)started before the next tree is ready
+    virtual std::string open() { return ""; }
+
     // Terminate current context, returned byte sequence is any remaining
     // data/end marker of current context.  Context object is invalid after
     // this, except the is_closed() function.
@@ -88,19 +101,44 @@ public:
     virtual ~Context() = default;
   };
 
+  // Context created by create_sequenced_context()
+  class SequencedContext : public Context {
+  public:
+    // As serialize(), but the record carries the given sequence number
+    virtual std::string serialize_sequenced(const Tree &&, uint64_t) = 0;
+  };
+
   // Return TRUE if the serialized output is binary, FALSE if it is text based
   virtual bool is_binary() = 0;
 
   virtual std::shared_ptr<Context> create_context() = 0;
 
+  // Return TRUE if the serializer can attach sequence numbers to records
+  virtual bool has_sequence_support() { return false; }
+
+  // Context where every record carries a sequence number, nullptr if the
+  // serializer doesn't support it
+  virtual std::shared_ptr<SequencedContext> create_sequenced_context() {
+    return nullptr;
+  }
+
+  // Context where the template of trees marked with Tree::mark_template() is
+  // only sent the first time it is seen, later records refer to it by id, see
+  // lioli_format_notes.txt. Works with any serializer, at most max_templates
+  // are remembered, the least recently used id is reused after that
+  std::shared_ptr<Context> create_templated_context(size_t max_templates);
+
   static std::shared_ptr<Serializer> &get_null_obj();
 };
 
 class Logger : public LogBase {
+  LoggerStats stats;
 
 public:
   Logger(const char *my_name) : LogBase(my_name) {}
 
+  LoggerStats &get_stats() { return stats; }
+
   // Must be non-blocking
   virtual void operator<<(const Tree &&tree) = 0;
 
@@ -0,0 +1,104 @@
+#ifndef logger_stats_c4f08e21
+#define logger_stats_c4f08e21
+
+// Snort includes
+#include <framework/counts.h>
+
+// System includes
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+// Local includes
+
+struct lua_State;
+
+namespace LioLi {
+
+// Lock-free log-linear histogram, each power of two is split into 16 linear
+// sub buckets, giving a max error of ~6% on the reported values
+class Histogram {
+  constexpr static unsigned sub_bits = 4;
+  constexpr static unsigned sub_count = 1 << sub_bits;
+  constexpr static unsigned bucket_count = (64 - sub_bits + 1) * sub_count;
+
+  std::array<std::atomic<uint64_t>, bucket_count> buckets = {};
+  std::atomic<uint64_t> count = 0;
+
+  static unsigned index_of(uint64_t value);
+  static uint64_t upper_bound_of(unsigned index);
+
+public:
+  void record(uint64_t value);
+
+  // Returns the upper bound of the bucket holding the given percentile (0-1),
+  // 0 if nothing is recorded
+  uint64_t percentile(double p) const;
+
+  uint64_t get_count() const { return count.load(std::memory_order_relaxed); }
+};
+
+// Statistics kept by every logger on the path from a tree being handed to the
+// logger (enqueue) until it is written
+class LoggerStats {
+public:
+  using clock = std::chrono::steady_clock;
+
+  // This must match the s_pegs[] array in logger_stats.cc
+  struct PegCounts {
+    PegCount trees_written = 0;
+    PegCount bytes_written = 0;
+    PegCount bytes_per_s = 0;
+    PegCount queue_depth = 0;
+    PegCount queue_depth_max = 0;
+    PegCount total_p50_us = 0;
+    PegCount total_p99_us = 0;
+    PegCount total_p999_us = 0;
+    PegCount wait_p99_us = 0;
+    PegCount serialize_p99_us = 0;
+    PegCount write_p99_us = 0;
+    PegCount tree_size_p50 = 0;
+    PegCount tree_size_p99 = 0;
+  };
+
+private:
+  Histogram wait;      // enqueue -> serialize
+  Histogram serialize; // serialize -> write
+  Histogram write;     // write -> written
+  Histogram total;     // enqueue -> written
+  Histogram tree_size; // Serialized bytes per tree
+
+  std::atomic<uint64_t> trees_written = 0;
+  std::atomic<uint64_t> bytes_written = 0;
+  std::atomic<uint64_t> queue_depth = 0;
+  std::atomic<uint64_t> queue_depth_max = 0;
+  std::atomic<clock::rep> first_write = 0; // 0 = nothing written yet
+
+public:
+  // Call when a tree is handed to the logger, depth is the queue depth
+  // including the new tree
+  void enqueued(size_t depth);
+
+  // Call when the queue depth changes for other reasons than enqueue
+  void set_queue_depth(size_t depth);
+
+  // Call when a tree has been written, with the time of each stage
+  void written(clock::time_point enqueue, clock::time_point serialize,
+               clock::time_point write, clock::time_point done, size_t bytes);
+
+  // Peg definitions for modules exposing logger statistics
+  static const PegInfo *get_pegs();
+  void fill(PegCounts &counts) const;
+
+  // Human readable dump of the current statistics
+  std::string dump(const char *name) const;
+
+  // Sends dump() to the control connection issuing the command
+  void respond(lua_State *L, const char *name) const;
+};
+
+} // namespace LioLi
+
+#endif // #ifndef logger_stats_c4f08e21
@@ -45,27 +45,63 @@ public:
 
   ~Serializer() = default;
 
-  class Context : public LioLi::Serializer::Context {
+  // Sequenced or not, as created
+  class Context : public LioLi::Serializer::SequencedContext {
     std::mutex mutex;
     LioLi::LioLi lioli;
+    bool sequenced = false;
     bool first_write = true;
     bool closed = false;
 
-  public:
-    std::string serialize(const LioLi::Tree &&tree) override {
-      std::scoped_lock lock(mutex);
+    // Must be called with mutex taken, returns false if the header couldn't
+    // be generated
+    bool insert_header() {
       if (first_write) {
         if (settings.option_no_root_node) {
           lioli.set_no_root_node();
         }
         if (settings.secret.size() != 9) {
           snort::ErrorMessage("ERROR: BILL secret not set to a valid value\n");
-          return "";
+          return false;
+        }
+        if (sequenced) {
+          lioli.set_sequenced();
         }
         lioli.set_secret(settings.secret);
         lioli.insert_header();
         first_write = false;
       }
+      return true;
+    }
+
+  public:
+    Context(bool sequenced = false) : sequenced(sequenced) {}
+
+    std::string open() override {
+      std::scoped_lock lock(mutex);
+      insert_header();
+      return lioli.move_binary();
+    }
+
+    std::string serialize(const LioLi::Tree &&tree) override {
+      std::scoped_lock lock(mutex);
+      assert(!sequenced);
+      if (!insert_header()) {
+        return "";
+      }
+      lioli << std::move(tree);
+
+      return lioli.move_binary();
+    }
+
+    std::string serialize_sequenced(const LioLi::Tree &&tree,
+                                    uint64_t sequence) override {
+      std::scoped_lock lock(mutex);
+      assert(sequenced);
+      if (!insert_header()) {
+        return "";
+      }
+      lioli.insert_sequence(sequence);
       lioli << std::move(tree);
 
       return lioli.move_binary();
@@ -94,6 +130,13 @@ public:
     std::shared_ptr<Context> context = std::make_shared<Context>();
     return context;
   };
+
+  bool has_sequence_support() override { return true; }
+
+  std::shared_ptr<LioLi::Serializer::SequencedContext>
+  create_sequenced_context() override {
+    return std::make_shared<Context>(true);
+  };
 };
 
 class Module : public snort::Module {
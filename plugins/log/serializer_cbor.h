@@ -0,0 +1,18 @@
+#ifndef serializer_cbor_8d02b7f5
+#define serializer_cbor_8d02b7f5
+
+// Snort includes
+#include <framework/base_api.h>
+#include <framework/inspector.h>
+
+// System includes
+
+// Local includes
+
+namespace serializer_cbor {
+
+extern const snort::InspectApi inspect_api;
+
+} // namespace serializer_cbor
+
+#endif // #ifndef serializer_cbor_8d02b7f5
@@ -0,0 +1,195 @@
+
+// Snort includes
+#include <framework/decode_data.h>
+#include <framework/inspector.h>
+#include <framework/module.h>
+
+// System includes
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+
+// Local includes
+#include "lioli.h"
+#include "lioli_columnar.h"
+#include "log_framework.h"
+#include "serializer_columnar.h"
+
+namespace serializer_columnar {
+namespace {
+
+static const char *s_name = "serializer_columnar";
+static const char *s_help =
+    "Serializes batches of LioLi trees to columnar blocks, one column per "
+    "absolute path";
+
+static const snort::Parameter module_params[] = {
+    {"batch_size", snort::Parameter::PT_INT, "1:1000000", "1024",
+     "Number of trees in each block"},
+    {"batch_seconds", snort::Parameter::PT_INT, "0:86400", "0",
+     "Max age of the first tree in a block, checked when a tree is added "
+     "(0 = no limit)"},
+    {nullptr, snort::Parameter::PT_MAX, nullptr, nullptr, nullptr}};
+
+// Settings for this module
+struct Settings {
+  uint32_t batch_size = 1024;
+  uint32_t batch_seconds = 0;
+} settings;
+
+// MAIN object of this file
+class Serializer : public LioLi::Serializer {
+
+public:
+  Serializer() : LioLi::Serializer(s_name) {}
+
+  ~Serializer() = default;
+
+  class Context : public LioLi::Serializer::Context {
+    using clock = std::chrono::steady_clock;
+
+    std::mutex mutex;
+    LioLi::Columnar::Writer writer;
+    clock::time_point batch_start;
+    bool first_write = true;
+    bool closed = false;
+
+    // Must be called with mutex taken
+    void insert_header(std::string &out) {
+      if (first_write) {
+        LioLi::Columnar::Writer::write_header(out);
+        first_write = false;
+      }
+    }
+
+  public:
+    std::string open() override {
+      std::scoped_lock lock(mutex);
+      std::string output;
+      insert_header(output);
+      return output;
+    }
+
+    std::string serialize(const LioLi::Tree &&tree) override {
+      std::string output;
+      serialize_into(std::move(tree), output);
+      return output;
+    }
+
+    // Trees are collected, so out is left empty until a block is complete
+    void serialize_into(const LioLi::Tree &&tree, std::string &out) override {
+      std::scoped_lock lock(mutex);
+      insert_header(out);
+
+      auto now = clock::now();
+      if (writer.get_rows() == 0) {
+        batch_start = now;
+      }
+
+      writer.add(tree);
+
+      if (writer.get_rows() >= settings.batch_size ||
+          (settings.batch_seconds &&
+           now - batch_start >= std::chrono::seconds(settings.batch_seconds))) {
+        writer.write_block(out);
+      }
+    }
+
+    // Terminate current context, returned byte sequence is any remaining
+    // data/end marker of current context.  Context object is invalid after
+    // this, except the is_closed() function.
+    std::string close() override {
+      std::scoped_lock lock(mutex);
+      std::string output;
+      if (!first_write) {
+        // Trees of an incomplete batch are written as a smaller block
+        writer.write_block(output);
+        LioLi::Columnar::Writer::write_end(output);
+      }
+      closed = true;
+      return output;
+    }
+
+    // Returns true if context is closed (invalid to call)
+    bool is_closed() override { return closed; }
+  };
+
+  // Return TRUE if the serialized output is binary, FALSE if it is text based
+  bool is_binary() override { return true; };
+
+  std::shared_ptr<LioLi::Serializer::Context> create_context() override {
+    return std::make_shared<Context>();
+  };
+};
+
+class Module : public snort::Module {
+  Module() : snort::Module(s_name, s_help, module_params) {
+    LioLi::LogDB::register_type<Serializer>();
+  }
+
+  bool begin(const char *, int, snort::SnortConfig *) override {
+    settings = Settings();
+    return true;
+  }
+
+  bool set(const char *, snort::Value &val, snort::SnortConfig *) override {
+    if (val.is("batch_size")) {
+      settings.batch_size = val.get_uint32();
+      return true;
+    } else if (val.is("batch_seconds")) {
+      settings.batch_seconds = val.get_uint32();
+      return true;
+    }
+
+    // fail as we got something we didn't understand
+    return false;
+  }
+
+  Usage get_usage() const override {
+    return GLOBAL;
+  } // TODO(mkr): Figure out what the usage type means
+
+public:
+  static snort::Module *ctor() { return new Module(); }
+  static void dtor(snort::Module *p) { delete p; }
+};
+
+class Inspector : public snort::Inspector {
+  void eval(snort::Packet *) override{};
+
+public:
+  static snort::Inspector *ctor(snort::Module *) { return new Inspector(); }
+  static void dtor(snort::Inspector *p) { delete p; }
+};
+
+} // namespace
+
+const snort::InspectApi inspect_api = {
+    {
+        PT_INSPECTOR,
+        sizeof(snort::InspectApi),
+        INSAPI_VERSION,
+        0,
+        API_RESERVED,
+        API_OPTIONS,
+        s_name,
+        s_help,
+        Module::ctor,
+        Module::dtor,
+    },
+
+    snort::IT_PASSIVE,
+    PROTO_BIT__NONE,
+    nullptr, // buffers
+    nullptr, // service
+    nullptr, // pinit
+    nullptr, // pterm
+    nullptr, // tinit
+    nullptr, // tterm
+    Inspector::ctor,
+    Inspector::dtor,
+    nullptr, // ssn
+    nullptr  // reset
+};
+
+} // namespace serializer_columnar
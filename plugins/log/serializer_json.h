@@ -0,0 +1,18 @@
+#ifndef serializer_json_3e6a91d4
+#define serializer_json_3e6a91d4
+
+// Snort includes
+#include <framework/base_api.h>
+#include <framework/inspector.h>
+
+// System includes
+
+// Local includes
+
+namespace serializer_json {
+
+extern const snort::InspectApi inspect_api;
+
+} // namespace serializer_json
+
+#endif // #ifndef serializer_json_3e6a91d4
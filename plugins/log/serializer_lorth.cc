@@ -38,6 +38,10 @@ public:
       return tree.as_lorth();
     }
 
+    void serialize_into(const LioLi::Tree &&tree, std::string &out) override {
+      tree.append_lorth(out);
+    }
+
     // Terminate current context, returned byte sequence is any remaining
     // data/end marker of current context.  Context object is invalid after
     // this, except the is_closed() function.
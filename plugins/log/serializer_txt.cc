@@ -35,8 +35,15 @@ public:
 
   public:
     std::string serialize(const LioLi::Tree &&tree) override {
-      return "vvvvvvvvvvvvvvvvvvvvvvvv\n" + tree.as_string() +
-             "^^^^^^^^^^^^^^^^^^^^^^^^\n";
+      std::string output;
+      serialize_into(std::move(tree), output);
+      return output;
+    }
+
+    void serialize_into(const LioLi::Tree &&tree, std::string &out) override {
+      out += "vvvvvvvvvvvvvvvvvvvvvvvv\n";
+      tree.append_string(out);
+      out += "^^^^^^^^^^^^^^^^^^^^^^^^\n";
     }
 
     // Terminate current context, returned byte sequence is any remaining
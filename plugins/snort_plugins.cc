@@ -11,15 +11,22 @@
 #include "alert_lioli/alert_lioli.h"
 #include "alert_lioli/ips_lioli_bind.h"
 #include "alert_lioli/ips_lioli_tag.h"
+#include "alert_lioli/lioli_history.h"
 #include "dhcp_monitor/inspector.h"
 #include "dhcp_option/inspector.h"
 #include "dhcp_option/ips_option.h"
 #include "dhcp_option/ips_option_ip_filter.h"
+#include "log/lioli_tree_logger.h"
+#include "log/logger_databus.h"
 #include "log/logger_file.h"
 #include "log/logger_null.h"
 #include "log/logger_pipe.h"
+#include "log/logger_ratelimit.h"
 #include "log/logger_stdout.h"
 #include "log/serializer_bill.h"
+#include "log/serializer_cbor.h"
+#include "log/serializer_columnar.h"
+#include "log/serializer_json.h"
 #include "log/serializer_lorth.h"
 #include "log/serializer_txt.h"
 #include "trout_netflow/trout_netflow.h"
@@ -33,11 +40,18 @@ SO_PUBLIC const snort::BaseApi *snort_plugins[] = {
   &ip_filter::ips_option.base,
   &ips_lioli_bind::ips_option.base,
   &ips_lioli_tag::ips_option.base,
+  &lioli_history::inspect_api.base,
+  &lioli_tree_logger::inspect_api.base,
+  &logger_databus::inspect_api.base,
   &logger_file::inspect_api.base,
   &logger_null::inspect_api.base,
   &logger_pipe::inspect_api.base,
+  &logger_ratelimit::inspect_api.base,
   &logger_stdout::inspect_api.base,
   &serializer_bill::inspect_api.base,
+  &serializer_cbor::inspect_api.base,
+  &serializer_columnar::inspect_api.base,
+  &serializer_json::inspect_api.base,
   &serializer_lorth::inspect_api.base,
   &serializer_txt::inspect_api.base,  
   &trout_netflow::inspect_api.base,
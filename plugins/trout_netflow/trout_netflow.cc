@@ -82,10 +82,10 @@ public:
 };
 
 class ServiceEventHandler : public snort::DataHandler {
-  Settings settings;
+  SettingsHandle settings;
 
 public:
-  ServiceEventHandler(Settings &settings)
+  ServiceEventHandler(const SettingsHandle &settings)
       : DataHandler(s_name), settings(settings) {}
 
   void handle(snort::DataEvent &, snort::Flow *flow) override {
@@ -101,12 +101,12 @@ public:
 };
 
 class Inspector : public snort::Inspector {
-  Settings settings;
+  SettingsHandle settings;
 
   Inspector(Module *module) {
     assert(module);
 
-    settings = module->get_settings();
+    settings = std::make_shared<const Settings>(module->get_settings());
   }
 
   void eval(snort::Packet *pkt) override {
@@ -121,7 +121,12 @@ class Inspector : public snort::Inspector {
     }
   };
 
-  bool configure(snort::SnortConfig *) {
+  bool configure(snort::SnortConfig *) override {
+    // Resolve the logger once, all flows share the resulting settings
+    Settings resolved = *settings;
+    resolved.logger = LioLi::LogDB::get<LioLi::Logger>(resolved.logger_name);
+    settings = std::make_shared<const Settings>(std::move(resolved));
+
     snort::DataBus::subscribe_network(
         snort::intrinsic_pub_key, snort::IntrinsicEventIds::FLOW_SERVICE_CHANGE,
         new ServiceEventHandler(settings));
@@ -5,6 +5,7 @@
 #include <framework/counts.h>
 
 // System includes
+#include <cassert>
 #include <memory>
 
 // Local includes
@@ -23,22 +24,23 @@ struct PegCounts {
 // This must match the s_pegs[] array
 extern THREAD_LOCAL struct PegCounts s_peg_counts;
 
-// Structure module level settings are transferred in
+// Structure module level settings are transferred in, the logger is resolved
+// when the inspector is configured, so no LogDB lookup is done when packets
+// are processed
 struct Settings {
-  std::shared_ptr<LioLi::Logger> logger;
-
-public:
   std::string logger_name;
   bool testmode = false;
+  std::shared_ptr<LioLi::Logger> logger;
 
-  LioLi::Logger &get_logger() {
-    if (!logger) {
-      logger = LioLi::LogDB::get<LioLi::Logger>(logger_name.c_str());
-    }
+  LioLi::Logger &get_logger() const {
+    assert(logger); // Must be resolved before use
     return *logger;
   }
 };
 
+// Immutable settings shared by the inspector and all flows
+using SettingsHandle = std::shared_ptr<const Settings>;
+
 } // namespace trout_netflow
 
 #endif // #ifndef trout_netflow_private_e55ebe42
@@ -16,7 +16,7 @@
 
 namespace trout_netflow {
 
-FlowData::FlowData(Settings &settings)
+FlowData::FlowData(const SettingsHandle &settings)
     : snort::FlowData(get_id()), settings(settings) {}
 
 unsigned FlowData::get_id() {
@@ -24,7 +24,8 @@ unsigned FlowData::get_id() {
   return flow_data_id;
 }
 
-FlowData *FlowData::get_from_flow(snort::Flow *flow, Settings &settings) {
+FlowData *FlowData::get_from_flow(snort::Flow *flow,
+                                  const SettingsHandle &settings) {
   assert(flow);
 
   FlowData *flow_data =
@@ -41,8 +42,8 @@ FlowData *FlowData::get_from_flow(snort::Flow *flow, Settings &settings) {
 
 FlowData::~FlowData() {
   auto tmp = gen_delta();
-  tmp << LioLi::TreeGenerators::timestamp("end_time", settings.testmode);
-  settings.get_logger() << std::move(tmp);
+  tmp << LioLi::TreeGenerators::timestamp("end_time", settings->testmode);
+  settings->get_logger() << std::move(tmp);
 }
 
 void FlowData::process(snort::Packet *pkt) {
@@ -50,20 +51,26 @@ void FlowData::process(snort::Packet *pkt) {
 
   // Note, this uses steady_clock instead of system_clock to ensure delta times
   // are correct
-  auto now = TestableTime::now<std::chrono::steady_clock>(settings.testmode);
+  auto now = TestableTime::now<std::chrono::steady_clock>(settings->testmode);
 
   if (first_pkt) {
     first_pkt_time = now;
     delta_pkt_time = now;
 
-    root << LioLi::TreeGenerators::timestamp("start_time", settings.testmode);
+    root << LioLi::TreeGenerators::timestamp("start_time", settings->testmode);
 
-    // format_IP_MAC handles a null flow
+    // format_IP_MAC handles a null flow. The addresses are in every record
+    // of the flow, so they are memoized to only be serialized once
     root << (LioLi::Tree("principal")
-             << LioLi::TreeGenerators::format_IP_MAC(pkt, pkt->flow, true));
+             << LioLi::TreeGenerators::format_IP_MAC(pkt, pkt->flow, true))
+                .memoize();
 
     root << (LioLi::Tree("endpoint")
-             << LioLi::TreeGenerators::format_IP_MAC(pkt, pkt->flow, false));
+             << LioLi::TreeGenerators::format_IP_MAC(pkt, pkt->flow, false))
+                .memoize();
+
+    // Only the counters change between the records of a flow
+    root.mark_template();
 
     first_pkt = false;
   }
@@ -88,20 +95,22 @@ LioLi::Tree FlowData::gen_delta() {
   auto now = std::chrono::steady_clock::now();
   delta_pkt_time = now;
 
-  auto tmp = root;
+  auto tmp = root; // With the template marked on root
+
   auto delta_root = delta.gen_tree();
-  delta_root << LioLi::TreeGenerators::timestamp("time", settings.testmode);
-  tmp << delta_root << acc.gen_tree();
+  delta_root << LioLi::TreeGenerators::timestamp("time", settings->testmode);
+  tmp << std::move(delta_root) << acc.gen_tree();
 
   delta.clear();
 
   return tmp;
 }
 
-void FlowData::dump_delta() { settings.get_logger() << gen_delta(); }
+void FlowData::dump_delta() { settings->get_logger() << gen_delta(); }
 
 void FlowData::set_service_name(const char *name) {
   root << (LioLi::Tree("service") << std::string(name));
+  root.mark_template();
   dump_delta();
 }
 
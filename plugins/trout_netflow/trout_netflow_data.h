@@ -19,7 +19,7 @@
 namespace trout_netflow {
 
 class FlowData : public snort::FlowData {
-  Settings settings;
+  SettingsHandle settings;
 
   LioLi::Tree root = {"$"};
 
@@ -69,11 +69,11 @@ class FlowData : public snort::FlowData {
   void dump_delta();
 
 public:
-  FlowData(Settings &);
+  FlowData(const SettingsHandle &);
   ~FlowData();
   unsigned static get_id();
 
-  static FlowData *get_from_flow(snort::Flow *flow, Settings &);
+  static FlowData *get_from_flow(snort::Flow *flow, const SettingsHandle &);
 
   void process(snort::Packet *);
 